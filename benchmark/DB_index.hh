@@ -312,6 +312,14 @@ public:
                    const std::array<access_t, C>& cell_accesses,
                    TObject* tobj, internal_elem* e,
                    std::array<void*, C>& split_values) {
+        // splits the scan does not access get no TransItem; split 0 is
+        // still read to skip deleted rows. Splits an earlier pass of a
+        // filtered scan has read are not read again.
+        if (split_values[I] || (I != 0 && cell_accesses[I] == access_t::none)) {
+            mvcc_scan_loop<C, I + 1, Rest...>(ret, count, cell_accesses, tobj, e, split_values);
+            return;
+        }
+
         auto mvobj = e->template chain_at<I>();
 
         auto h = mvobj->find(Sto::read_tid());
@@ -326,23 +334,19 @@ public:
         }
         */
 
-        TransProxy row_item =
-            IndexType::index_read_my_write
-                ? Sto::item(tobj, item_key_t(e, I))
-                : Sto::fresh_item(tobj, item_key_t(e, I));
-
         if (I == 0) {
             if (h->status_is(DELETED)) {
-                MvAccess::template read<First>(row_item, h);
+                MvAccess::template read<First>(Sto::item(tobj, item_key_t(e, I)), h);
                 count = false;
                 return;
             } else if (IndexType::index_read_my_write) {
-                if (IndexType::has_delete(row_item)) {
+                auto row_item = Sto::check_item(tobj, item_key_t(e, I));
+                if (row_item && IndexType::has_delete(*row_item)) {
                     count = false;
                     return;
                 }
-                if (IndexType::has_row_update(row_item)) {
-                    split_values[I] = row_item.template raw_write_value<First*>();
+                if (row_item && IndexType::has_row_update(*row_item)) {
+                    split_values[I] = row_item->template raw_write_value<First*>();
                     mvcc_scan_loop<C, I + 1, Rest...>(ret, count, cell_accesses, tobj, e, split_values);
                     return;
                 }
@@ -350,6 +354,10 @@ public:
         }
 
         if (cell_accesses[I] != access_t::none) {
+            TransProxy row_item =
+                IndexType::index_read_my_write
+                    ? Sto::item(tobj, item_key_t(e, I))
+                    : Sto::fresh_item(tobj, item_key_t(e, I));
             MvAccess::template read<First>(row_item, h);
             auto vptr = h->vp();
             //ret &= callback(IndexType::key_type(key), *vptr);
@@ -365,6 +373,54 @@ public:
         return true;
     }
 
+    // Snapshot variants of the select and scan loops for read-only snapshot
+    // transactions (Sto::mvcc_ro()): versions are read directly at read_tid
+    // and no TransItems are created.
+    template <int C, int I, typename First, typename... Rest>
+    static bool
+    mvcc_snapshot_select_loop(const std::array<access_t, C>& cell_accesses,
+                              std::array<void*, C>& value_ptrs, internal_elem* e) {
+        if (cell_accesses[I] != access_t::none) {
+            assert((cell_accesses[I] & access_t::write) == access_t::none);
+            auto h = e->template chain_at<I>()->find(Sto::read_tid());
+            if (h->status_is(COMMITTED_DELETED)) {
+                return false;
+            } else if (!h->status_is(DELETED)) {
+                auto vp = h->vp();
+                assert(vp);
+                value_ptrs[I] = vp;
+            }
+        }
+        return mvcc_snapshot_select_loop<C, I + 1, Rest...>(cell_accesses, value_ptrs, e);
+    }
+
+    template <int C, int I>
+    static bool
+    mvcc_snapshot_select_loop(const std::array<access_t, C>&, std::array<void*, C>&, internal_elem*) {
+        static_assert(I == C, "Index invalid.");
+        return true;
+    }
+
+    template <int C, int I, typename First, typename... Rest>
+    static void
+    mvcc_snapshot_scan_loop(bool& count, const std::array<access_t, C>& cell_accesses,
+                            internal_elem* e, std::array<void*, C>& split_values) {
+        auto h = e->template chain_at<I>()->find(Sto::read_tid());
+        if (I == 0 && h->status_is(DELETED)) {
+            count = false;
+            return;
+        }
+        if (cell_accesses[I] != access_t::none)
+            split_values[I] = h->vp();
+        mvcc_snapshot_scan_loop<C, I + 1, Rest...>(count, cell_accesses, e, split_values);
+    }
+
+    template <int C, int I>
+    static void
+    mvcc_snapshot_scan_loop(bool&, const std::array<access_t, C>&, internal_elem*, std::array<void*, C>&) {
+        static_assert(I == C, "Index invalid.");
+    }
+
     // Generate loops for non-trans access. P is SplitParams.
     template <int C, int I, typename P, typename First, typename... Rest>
     static void
@@ -498,7 +554,10 @@ public:
                 TObject* tobj,
                 internal_elem* e) {
             std::array<void*, P::num_splits> value_ptrs = { nullptr };
-            *found = mvcc_select_loop<P::num_splits, 0, SplitTypes...>(cell_accesses, value_ptrs, tobj, e);
+            if (Sto::mvcc_ro())
+                *found = mvcc_snapshot_select_loop<P::num_splits, 0, SplitTypes...>(cell_accesses, value_ptrs, e);
+            else
+                *found = mvcc_select_loop<P::num_splits, 0, SplitTypes...>(cell_accesses, value_ptrs, tobj, e);
             return value_ptrs;
         }
         template <typename Callback>
@@ -513,7 +572,49 @@ public:
             ret = true;
             count = true;
             std::array<void*, P::num_splits> split_values = { nullptr };
-            mvcc_scan_loop<P::num_splits, 0, SplitTypes...>(ret, count, cell_accesses, tobj, e, split_values);
+            if (Sto::mvcc_ro())
+                mvcc_snapshot_scan_loop<P::num_splits, 0, SplitTypes...>(count, cell_accesses, e, split_values);
+            else
+                mvcc_scan_loop<P::num_splits, 0, SplitTypes...>(ret, count, cell_accesses, tobj, e, split_values);
+
+            if (ret && count) {
+                return callback((typename IndexType::key_type)(key), split_values);
+            } else {
+                return ret;
+            }
+        }
+        // Reads the projection splits, then the rest only if `predicate`
+        // accepts the row
+        template <typename Predicate, typename Callback>
+        static bool run_filtered_scan_callback(
+                bool& ret,
+                bool& count,
+                const std::array<access_t, P::num_splits>& proj_accesses,
+                const std::array<access_t, P::num_splits>& rest_accesses,
+                const lcdf::Str& key,
+                TObject* tobj,
+                internal_elem* e,
+                Predicate predicate,
+                Callback callback) {
+            ret = true;
+            count = true;
+            std::array<void*, P::num_splits> split_values = { nullptr };
+            if (Sto::mvcc_ro())
+                mvcc_snapshot_scan_loop<P::num_splits, 0, SplitTypes...>(count, proj_accesses, e, split_values);
+            else
+                mvcc_scan_loop<P::num_splits, 0, SplitTypes...>(ret, count, proj_accesses, tobj, e, split_values);
+            if (!ret || !count)
+                return ret;
+
+            if (!predicate((typename IndexType::key_type)(key), split_values)) {
+                count = false;
+                return true;
+            }
+
+            if (Sto::mvcc_ro())
+                mvcc_snapshot_scan_loop<P::num_splits, 0, SplitTypes...>(count, rest_accesses, e, split_values);
+            else
+                mvcc_scan_loop<P::num_splits, 0, SplitTypes...>(ret, count, rest_accesses, tobj, e, split_values);
 
             if (ret && count) {
                 return callback((typename IndexType::key_type)(key), split_values);
@@ -682,6 +783,12 @@ public:
             return &std::get<I>(split_row);
         }
 
+        // Counts the history of every split under MvRegistry table `id`
+        void gc_table(unsigned id) {
+            if (id)
+                std::apply([id](auto&... chains) { (chains.gc_table(id), ...); }, split_row);
+        }
+
         static intptr_t row_chain_offset() {
             void* base = nullptr;
             const auto base_address = reinterpret_cast<intptr_t>(base);
@@ -725,7 +832,7 @@ bool mvcc_chain_operations<K, V, DBParams>::lock_impl_per_chain(
 
     if (item.has_read()) {
         auto hprev = item.read_value<history_type*>();
-        if (Sto::commit_tid() < hprev->rtid()) {
+        if (chain->read_past(Sto::commit_tid(), hprev)) {
             TransProxy(txn, item).add_write(nullptr);
             TXP_ACCOUNT(txp_tpcc_lock_abort1, txn.special_txp);
             return false;
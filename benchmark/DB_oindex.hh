@@ -1,8 +1,229 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
 #include "DB_index.hh"
 
 namespace bench {
+
+// Bulk loader for the ordered indexes.
+//
+// The loader owns nthreads threads, which run as TThreads 0 to
+// nthreads - 1 and live as long as the loader, so loading any number of
+// tables makes one masstree threadinfo per thread and index type. Rows are
+// streamed into a table through table_stream::add() and loaded in batches
+// of up to batch_size rows: the loader threads sort each batch into
+// masstree key order, unless it already is, keep the last of rows with
+// equal keys, and then each thread inserts a contiguous run of keys in key
+// order, so threads fill disjoint leaves and each descent finds most of the
+// previous one's path in cache. The next batch is filled while one is
+// being inserted. The result matches calling nontrans_put on each row in
+// order. With 0 threads, add() calls nontrans_put itself.
+//
+// No transactions may run while a loader exists.
+class ordered_bulk_loader {
+public:
+    static constexpr size_t default_batch_size = 1 << 16;
+
+    template <typename Index>
+    class table_stream {
+    public:
+        typedef typename Index::key_type key_type;
+        typedef typename Index::value_type value_type;
+        typedef std::pair<key_type, value_type> row_type;
+
+        table_stream(ordered_bulk_loader& loader, Index& idx)
+            : loader_(loader), idx_(idx), nrows_(0), seconds_(0) {}
+        table_stream(table_stream&&) = default;
+        ~table_stream() {
+            finish();
+        }
+
+        void add(const key_type& k, const value_type& v) {
+            ++nrows_;
+            if (!loader_.nthreads_) {
+                auto start = std::chrono::steady_clock::now();
+                idx_.nontrans_put(k, v);
+                seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                return;
+            }
+            batch_.emplace_back(k, v);
+            if (batch_.size() == loader_.batch_size_)
+                flush();
+        }
+        // Loads the rows added so far and waits for them
+        void finish() {
+            flush();
+            loader_.wait();
+        }
+
+        size_t rows() const {
+            return nrows_;
+        }
+        // Time the loader spent on this table's rows: the loader threads'
+        // wall-clock time, or that of the nontrans_put calls with 0 threads
+        double seconds() const {
+            return seconds_;
+        }
+
+    private:
+        ordered_bulk_loader& loader_;
+        Index& idx_;
+        std::vector<row_type> batch_;
+        std::vector<row_type> loading_;
+        std::vector<const row_type*> sorted_;
+        size_t nrows_;
+        double seconds_;
+
+        void flush() {
+            if (batch_.empty())
+                return;
+            loader_.wait();
+            loading_.clear();
+            std::swap(batch_, loading_);
+            loader_.sort(loading_, sorted_, seconds_);
+            loader_.run([this] (int t, int nthreads) {
+                Index::thread_init();
+                size_t n = sorted_.size();
+                for (size_t i = n * t / nthreads; i != n * (t + 1) / nthreads; ++i)
+                    idx_.nontrans_put(sorted_[i]->first, sorted_[i]->second);
+            }, seconds_);
+        }
+    };
+
+    explicit ordered_bulk_loader(int nthreads, size_t batch_size = default_batch_size)
+        : nthreads_(nthreads), batch_size_(batch_size), job_id_(0), running_(0),
+          stopping_(false), elapsed_(nullptr) {
+        for (int t = 0; t < nthreads; ++t)
+            threads_.emplace_back(&ordered_bulk_loader::thread_main, this, t);
+    }
+    ~ordered_bulk_loader() {
+        wait();
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& th : threads_)
+            th.join();
+    }
+
+    int nthreads() const {
+        return nthreads_;
+    }
+
+    // Streams rows into idx; the rows are loaded at the latest when the
+    // stream is finished or destroyed
+    template <typename Index>
+    table_stream<Index> stream(Index& idx) {
+        return table_stream<Index>(*this, idx);
+    }
+
+private:
+    typedef std::function<void(int, int)> job_type;
+
+    int nthreads_;
+    size_t batch_size_;
+    std::vector<std::thread> threads_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    job_type job_;
+    uint64_t job_id_;
+    int running_;
+    bool stopping_;
+    std::chrono::steady_clock::time_point job_start_;
+    double* elapsed_;
+
+    // Runs f(t, nthreads) on every loader thread t and returns at once. The
+    // job's wall-clock time is added to elapsed when the last thread
+    // finishes. Jobs run one at a time; call wait() first.
+    void run(job_type f, double& elapsed) {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            assert(running_ == 0);
+            job_ = std::move(f);
+            ++job_id_;
+            running_ = nthreads_;
+            job_start_ = std::chrono::steady_clock::now();
+            elapsed_ = &elapsed;
+        }
+        wake_.notify_all();
+    }
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock_);
+        done_.wait(guard, [this] { return running_ == 0; });
+    }
+    void thread_main(int t) {
+        TThread::set_id(t);
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> guard(lock_);
+        while (true) {
+            wake_.wait(guard, [&] { return stopping_ || job_id_ != seen; });
+            if (stopping_)
+                return;
+            seen = job_id_;
+            guard.unlock();
+            job_(t, nthreads_);
+            guard.lock();
+            if (--running_ == 0) {
+                *elapsed_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - job_start_).count();
+                done_.notify_all();
+            }
+        }
+    }
+
+    // Points sorted at rows in key order, keeping the last of rows with
+    // equal keys. Each thread sorts one slice, then pairs of neighboring
+    // runs are merged in parallel.
+    template <typename Row>
+    void sort(const std::vector<Row>& rows, std::vector<const Row*>& sorted, double& elapsed) {
+        sorted.resize(rows.size());
+        for (size_t i = 0; i != rows.size(); ++i)
+            sorted[i] = &rows[i];
+        auto less = [] (const Row* a, const Row* b) {
+            return key_less(a->first, b->first);
+        };
+        if (!std::is_sorted(sorted.begin(), sorted.end(), less)) {
+            size_t n = sorted.size();
+            run([&] (int t, int nthreads) {
+                std::stable_sort(sorted.begin() + n * t / nthreads,
+                                 sorted.begin() + n * (t + 1) / nthreads, less);
+            }, elapsed);
+            wait();
+            for (int width = 1; width < nthreads_; width *= 2) {
+                run([&, width] (int t, int nthreads) {
+                    if (t % (2 * width) != 0 || t + width >= nthreads)
+                        return;
+                    std::inplace_merge(sorted.begin() + n * t / nthreads,
+                                       sorted.begin() + n * (t + width) / nthreads,
+                                       sorted.begin() + n * std::min(t + 2 * width, nthreads) / nthreads,
+                                       less);
+                }, elapsed);
+                wait();
+            }
+        }
+        auto last = std::unique(sorted.rbegin(), sorted.rend(), [&] (const Row* a, const Row* b) {
+            return !less(a, b) && !less(b, a);
+        });
+        sorted.erase(sorted.begin(), last.base());
+    }
+
+    // Compares keys as masstree does: bytewise, then by length
+    template <typename K>
+    static bool key_less(const K& a, const K& b) {
+        lcdf::Str sa = a;
+        lcdf::Str sb = b;
+        int c = memcmp(sa.data(), sb.data(), std::min(sa.length(), sb.length()));
+        return c < 0 || (c == 0 && sa.length() < sb.length());
+    }
+};
+
 template <typename K, typename V, typename DBParams>
 class ordered_index : public TObject {
 public:
@@ -147,6 +368,22 @@ public:
         };
     }
 
+    // Looks up nkeys keys at once, for select_split_row(rid, ...); rows[i]
+    // is set to the row id of keys[i], or to 0 if it is absent. Same
+    // interface as unordered_index::multi_select_row, but the keys are
+    // looked up one after another: masstree already prefetches the nodes
+    // of each descent. Returns false if the transaction must abort.
+    bool multi_select_row(const key_type* keys, size_t nkeys, uintptr_t* rows) {
+        for (size_t i = 0; i != nkeys; ++i) {
+            unlocked_cursor_type lp(table_, keys[i]);
+            bool found = lp.find_unlocked(*ti);
+            rows[i] = found ? reinterpret_cast<uintptr_t>(lp.value()) : 0;
+            if (!found && !register_internode_version(lp.node(), lp))
+                return false;
+        }
+        return true;
+    }
+
 #if 0
     sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
@@ -524,6 +761,86 @@ public:
         return scanner.scan_succeeded_;
     }
 
+    // Like range_scan, but hands each row to `predicate(key, value)` before
+    // `callback`, and only rows it accepts cost more than the cells of the
+    // `projection` columns the predicate reads. Those cells are observed for
+    // every row, so a change that would let a filtered row in is caught at
+    // commit; the rest of `accesses` is registered for accepted rows only.
+    // Filtered rows do not count toward `limit`. Leaf node versions are
+    // tracked as in range_scan.
+    template <typename Predicate, typename Callback, bool Reverse>
+    bool filtered_range_scan(const key_type& begin, const key_type& end,
+                             Predicate predicate, std::initializer_list<column_access_t> projection,
+                             Callback callback, std::initializer_list<column_access_t> accesses,
+                             bool phantom_protection = true, int limit = -1) {
+        assert((limit == -1) || (limit > 0));
+        auto node_callback = [&] (leaf_type* node,
+            typename unlocked_cursor_type::nodeversion_value_type version) {
+            return ((!phantom_protection) || scan_track_node_version(node, version));
+        };
+
+        auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
+        auto proj_accesses = column_to_cell_accesses<value_container_type>(projection);
+        auto rest_accesses = cell_accesses;
+        for (size_t idx = 0; idx < proj_accesses.size(); ++idx) {
+            if (proj_accesses[idx] != access_t::none) {
+                proj_accesses[idx] = access_t::read;
+                rest_accesses[idx] = rest_accesses[idx] & access_t::write;
+            }
+        }
+
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            ret = true;
+            if (index_read_my_write) {
+                auto row_item = Sto::check_item(this, item_key_t::row_item_key(e));
+                if (row_item && has_delete(*row_item)) {
+                    count = false;
+                    return true;
+                }
+                if (has_cell_write(proj_accesses, e) || has_cell_write(cell_accesses, e)) {
+                    TransProxy item = Sto::item(this, item_key_t::row_item_key(e));
+                    const value_type* value = has_insert(item) ? &(e->row_container.row)
+                                                               : item.template raw_write_value<value_type *>();
+                    if (predicate(key_type(key), value))
+                        ret = callback(key_type(key), value);
+                    else
+                        count = false;
+                    return true;
+                }
+            }
+
+            auto proj_items = extract_item_list<value_container_type>(proj_accesses, this, e).second;
+            if (!access_all(proj_accesses, proj_items, e->row_container))
+                return false;
+
+            // skip invalid (inserted but yet committed) values, but do not
+            // abort; the row version tells whether the insert commits
+            if (!e->valid()) {
+                count = false;
+                return Sto::item(this, item_key_t::row_item_key(e)).observe(e->version());
+            }
+
+            if (!predicate(key_type(key), &(e->row_container.row))) {
+                count = false;
+                return true;
+            }
+
+            auto rest_items = extract_item_list<value_container_type>(rest_accesses, this, e).second;
+            if (!access_all(rest_accesses, rest_items, e->row_container))
+                return false;
+            ret = callback(key_type(key), &(e->row_container.row));
+            return true;
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), Reverse>
+            scanner(end, node_callback, value_callback, limit);
+        if (Reverse)
+            table_.rscan(begin, true, scanner, *ti);
+        else
+            table_.scan(begin, true, scanner, *ti);
+        return scanner.scan_succeeded_;
+    }
+
     value_type *nontrans_get(const key_type& k) {
         unlocked_cursor_type lp(table_, k);
         bool found = lp.find_unlocked(*ti);
@@ -534,6 +851,12 @@ public:
             return nullptr;
     }
 
+    // Streams rows into this index on loader's threads; see
+    // ordered_bulk_loader
+    ordered_bulk_loader::table_stream<ordered_index> bulk_load(ordered_bulk_loader& loader) {
+        return loader.stream(*this);
+    }
+
     void nontrans_put(const key_type& k, const value_type& v) {
         cursor_type lp(table_, k);
         bool found = lp.find_insert(*ti);
@@ -796,6 +1119,20 @@ private:
         return true;
     }
 
+    // True if this transaction wrote any of the cells, without adding items
+    // for the ones it has not touched
+    bool has_cell_write(const std::array<access_t, value_container_type::num_versions>& cell_accesses,
+                        internal_elem *e) const {
+        for (size_t idx = 0; idx < cell_accesses.size(); ++idx) {
+            if (cell_accesses[idx] == access_t::none)
+                continue;
+            auto item = Sto::check_item(this, item_key_t(e, idx));
+            if (item && item->has_write())
+                return true;
+        }
+        return false;
+    }
+
     static bool has_insert(const TransItem& item) {
         return (item.flags() & insert_bit) != 0;
     }
@@ -1023,6 +1360,12 @@ public:
         return fetch_and_add(&key_gen_, 1);
     }
 
+    // Names this index for MvRegistry's per-table history accounting.
+    // Rows inserted afterwards are counted under it.
+    void gc_table(const std::string& name) {
+        gc_table_id_ = MvRegistry::table_id(name);
+    }
+
     sel_return_type
     select_row(const key_type& key, RowAccess acc) {
         unlocked_cursor_type lp(table_, key);
@@ -1065,8 +1408,9 @@ public:
         if (found) {
             return select_splits(reinterpret_cast<uintptr_t>(e), accesses);
         } else {
+            // snapshot reads cannot observe later inserts; skip phantom protection
             return {
-                register_internode_version(lp.node(), lp.full_version_value()),
+                Sto::mvcc_ro() || register_internode_version(lp.node(), lp.full_version_value()),
                 false,
                 0,
                 SplitRecordAccessor<V>({ nullptr })
@@ -1074,6 +1418,25 @@ public:
         }
     }
 
+    // Split version select row, by a row id from multi_select_row
+    sel_split_return_type
+    select_split_row(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
+        return select_splits(rid, accesses);
+    }
+
+    // Looks up nkeys keys at once; see ordered_index
+    bool multi_select_row(const key_type* keys, size_t nkeys, uintptr_t* rows) {
+        for (size_t i = 0; i != nkeys; ++i) {
+            unlocked_cursor_type lp(table_, keys[i]);
+            bool found = lp.find_unlocked(*ti);
+            rows[i] = found ? reinterpret_cast<uintptr_t>(lp.value()) : 0;
+            if (!found && !Sto::mvcc_ro()
+                && !register_internode_version(lp.node(), lp.full_version_value()))
+                return false;
+        }
+        return true;
+    }
+
     sel_split_return_type
     select_splits(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
         using split_params = SplitParams<value_type>;
@@ -1110,6 +1473,7 @@ public:
         internal_elem *e;
         if (!found) {
             e = new internal_elem(this, key);
+            e->gc_table(gc_table_id_);
             lp.value() = e;
 
             node_type *node;
@@ -1243,6 +1607,7 @@ public:
                     std::initializer_list<column_access_t> accesses,
                     bool phantom_protection = true, int limit = -1) {
         assert((limit == -1) || (limit > 0));
+        phantom_protection = phantom_protection && !Sto::mvcc_ro();
         auto cell_accesses = mvcc_column_to_cell_accesses<SplitParams<value_type>>(accesses);
         auto node_callback = [&] (leaf_type* node,
                                   typename unlocked_cursor_type::nodeversion_value_type version) {
@@ -1267,6 +1632,7 @@ public:
     bool range_scan(const key_type& begin, const key_type& end, Callback callback,
                     RowAccess access, bool phantom_protection = true, int limit = -1) {
         // TODO: Scan ignores blind writes right now
+        phantom_protection = phantom_protection && !Sto::mvcc_ro();
         access_t each_cell = access_t::none;
         if (access == RowAccess::ObserveValue || access == RowAccess::ObserveExists) {
             each_cell = access_t::read;
@@ -1296,6 +1662,43 @@ public:
         return scanner.scan_succeeded_;
     }
 
+    // See ordered_index::filtered_range_scan. Rows the predicate rejects
+    // register reads of the projection splits only; in read-only snapshot
+    // transactions nothing is registered either way.
+    template <typename Predicate, typename Callback, bool Reverse>
+    bool filtered_range_scan(const key_type& begin, const key_type& end,
+                             Predicate predicate, std::initializer_list<column_access_t> projection,
+                             Callback callback, std::initializer_list<column_access_t> accesses,
+                             bool phantom_protection = true, int limit = -1) {
+        assert((limit == -1) || (limit > 0));
+        phantom_protection = phantom_protection && !Sto::mvcc_ro();
+        auto proj_accesses = mvcc_column_to_cell_accesses<SplitParams<value_type>>(projection);
+        auto rest_accesses = mvcc_column_to_cell_accesses<SplitParams<value_type>>(accesses);
+        for (size_t idx = 0; idx < proj_accesses.size(); ++idx) {
+            if (proj_accesses[idx] != access_t::none) {
+                proj_accesses[idx] = access_t::read;
+                rest_accesses[idx] = rest_accesses[idx] & access_t::write;
+            }
+        }
+        auto node_callback = [&] (leaf_type* node,
+                                  typename unlocked_cursor_type::nodeversion_value_type version) {
+            return ((!phantom_protection) || register_internode_version(node, version));
+        };
+
+        auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            return MvSplitAccessAll::template run_filtered_scan_callback<Predicate, Callback>(
+                    ret, count, proj_accesses, rest_accesses, key, this, e, predicate, callback);
+        };
+
+        range_scanner<decltype(node_callback), decltype(value_callback), Reverse>
+                scanner(end, node_callback, value_callback, limit);
+        if (Reverse)
+            table_.rscan(begin, true, scanner, *ti);
+        else
+            table_.scan(begin, true, scanner, *ti);
+        return scanner.scan_succeeded_;
+    }
+
     bool nontrans_get(const key_type& k, value_type* value_out) {
         unlocked_cursor_type lp(table_, k);
         bool found = lp.find_unlocked(*ti);
@@ -1308,6 +1711,12 @@ public:
         }
     }
 
+    // Streams rows into this index on loader's threads; see
+    // ordered_bulk_loader
+    ordered_bulk_loader::table_stream<mvcc_ordered_index> bulk_load(ordered_bulk_loader& loader) {
+        return loader.stream(*this);
+    }
+
     void nontrans_put(const key_type& k, const value_type& v) {
         cursor_type lp(table_, k);
         bool found = lp.find_insert(*ti);
@@ -1317,6 +1726,7 @@ public:
             lp.finish(0, *ti);
         } else {
             internal_elem *e = new internal_elem(this, k);
+            e->gc_table(gc_table_id_);
             MvSplitAccessAll::run_nontrans_put(v, e);
             lp.value() = e;
             lp.finish(1, *ti);
@@ -1451,6 +1861,7 @@ public:
 //private:
     table_type table_;
     uint64_t key_gen_;
+    unsigned gc_table_id_ = 0;
 
     //static bool
     //access_all(std::array<access_t, internal_elem::num_versions>&, std::array<TransItem*, internal_elem::num_versions>&, internal_elem*) {
@@ -7,10 +7,10 @@ namespace db_params {
 
 // Benchmark parameters
 constexpr const char *db_params_id_names[] = {
-    "none", "default", "opaque", "2pl", "adaptive", "swiss", "tictoc", "mvcc"};
+    "none", "default", "opaque", "2pl", "adaptive", "swiss", "tictoc", "mvcc", "mvcclease"};
 
 enum class db_params_id : int {
-    None = 0, Default, Opaque, TwoPL, Adaptive, Swiss, TicToc, MVCC
+    None = 0, Default, Opaque, TwoPL, Adaptive, Swiss, TicToc, MVCC, MVCCLease
 };
 
 inline std::ostream &operator<<(std::ostream &os, const db_params_id &id) {
@@ -43,6 +43,10 @@ public:
     static constexpr bool MVCC = false;
     static constexpr bool NodeTrack = false;
     static constexpr bool Commute = false;
+    // unordered_index buckets keep rows in tagged slots; see slot_bucket
+    static constexpr bool SlotBuckets = false;
+    // MVCC read lease in transactions; see Transaction::set_mvcc_read_lease
+    static constexpr unsigned MvReadLease = 0;
 };
 
 class db_default_commute_params : public db_default_params {
@@ -112,6 +116,29 @@ public:
     static constexpr bool Commute = true;
 };
 
+// MVCC whose readers extend version rtids by a lease, so that most reads
+// of hot rows do not write to them
+class db_mvcc_lease_params : public db_mvcc_params {
+public:
+    static constexpr db_params_id Id = db_params_id::MVCCLease;
+    static constexpr unsigned MvReadLease = 64;
+};
+
+class db_mvcc_lease_commute_params : public db_mvcc_lease_params {
+public:
+    static constexpr bool Commute = true;
+};
+
+class db_default_slot_params : public db_default_params {
+public:
+    static constexpr bool SlotBuckets = true;
+};
+
+class db_default_commute_slot_params : public db_default_commute_params {
+public:
+    static constexpr bool SlotBuckets = true;
+};
+
 class db_default_node_params : public db_default_params {
 public:
     static constexpr bool NodeTrack = true;
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <fstream>
+#include <string>
+
 #include "SystemProfiler.hh"
 #include "Transaction.hh"
+#include "MVCCRegistry.hh"
 #include "DB_params.hh"
 
 namespace bench {
@@ -31,6 +35,14 @@ public:
         return start_tsc_;
     }
 
+    // Have finish() write STO latency histograms (needs a TSC_PROFILE=1
+    // build) and MVCC per-table history statistics to file as JSON,
+    // tagged with label (e.g. the CC mode).
+    void dump_latency_json(const std::string& file, const std::string& label) {
+        latency_json_ = file;
+        latency_label_ = label;
+    }
+
     double finish(size_t num_txns) {
         end_tsc_ = read_tsc();
         if (spawn_perf_) {
@@ -47,6 +59,18 @@ public:
         // print STO stats
         Transaction::print_stats();
 
+        if (!latency_json_.empty()) {
+            std::ofstream f(latency_json_);
+            f << "{\"label\":\"" << latency_label_ << "\",\"txns\":" << num_txns
+              << ",\"elapsed_ms\":" << elapsed_time << ",\"latency\":";
+            Transaction::print_latency_json(f, constants::processor_tsc_frequency);
+            f << ",\"mvcc_tables\":";
+            MvRegistry::print_json(f);
+            f << "}" << std::endl;
+            if (!f)
+                std::cerr << "Warning: could not write " << latency_json_ << std::endl;
+        }
+
         // return elapsed ms
         return elapsed_time;
     }
@@ -56,6 +80,8 @@ private:
     pid_t perf_pid_;
     uint64_t start_tsc_;
     uint64_t end_tsc_;
+    std::string latency_json_;
+    std::string latency_label_;
 };
 
 }; // namespace bench
@@ -1,8 +1,334 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
 #include "DB_index.hh"
 
 namespace bench {
+
+// Bucket array of the unordered indexes, grown online by linear hashing.
+//
+// Buckets live in segments that are never moved or freed while the index
+// exists, so TransItems keep pointing at them across growth. Segment 0
+// holds the initial buckets and segment s > 0 the next base << (s - 1).
+// Once the table holds more than max_load nodes per bucket, inserting
+// threads split up to max_splits_per_check buckets, in linear hashing
+// order, every grow_check_interval inserts. One thread splits at a time;
+// the others carry on unless the table has fallen to half its target
+// size, in which case they wait their turn. A split moves the nodes that
+// now hash to the new bucket, with both buckets locked, and bumps the old
+// bucket's version. Transactions that observed the old bucket (for
+// example an absent key) therefore fail validation; transactions that
+// look afterwards observe whichever bucket the key now maps to.
+//
+// Bucket is a chained_bucket or a slot_bucket.
+template <typename Bucket>
+class linear_hash_buckets {
+public:
+    static constexpr unsigned max_segments = 48;
+    static constexpr unsigned count_stripes = 16;
+    static constexpr unsigned grow_check_interval = 16;
+    static constexpr unsigned max_splits_per_check = 256;
+
+    explicit linear_hash_buckets(size_t nbuckets, double max_load = Bucket::max_load)
+        : base_(std::max(nbuckets, size_t(1))), n_(base_), max_load_(max_load) {
+        segments_[0].store(new Bucket[base_], std::memory_order_relaxed);
+        for (unsigned s = 1; s != max_segments; ++s)
+            segments_[s].store(nullptr, std::memory_order_relaxed);
+    }
+    ~linear_hash_buckets() {
+        for (auto& s : segments_)
+            delete[] s.load(std::memory_order_relaxed);
+    }
+
+    size_t size() const {
+        return n_.load(std::memory_order_acquire);
+    }
+    // Nodes inserted minus nodes removed; approximate while threads run
+    size_t count() const {
+        int64_t c = 0;
+        for (auto& st : stripes_)
+            c += st.inserts.load(std::memory_order_relaxed) - st.removes.load(std::memory_order_relaxed);
+        return std::max(c, int64_t(0));
+    }
+
+    size_t index(size_t h) const {
+        size_t n = size();
+        size_t level_size = level_size_of(n);
+        size_t i = h % level_size;
+        if (i < n - level_size)
+            i = h % (level_size * 2);
+        return i;
+    }
+    Bucket& at(size_t i) const {
+        if (i < base_)
+            return segments_[0].load(std::memory_order_relaxed)[i];
+        unsigned s = segment_of(i);
+        return segments_[s].load(std::memory_order_relaxed)[i - (base_ << (s - 1))];
+    }
+
+    // Locks and returns the bucket hash h maps to, rechecking the mapping
+    // under the lock so a concurrent split cannot move it away
+    Bucket& lock(size_t h) {
+        while (true) {
+            size_t i = index(h);
+            Bucket& buck = at(i);
+            buck.version.lock_exclusive();
+            if (index(h) == i)
+                return buck;
+            buck.version.unlock_exclusive();
+        }
+    }
+
+    void note_remove() {
+        stripe().removes.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Counts an inserted node and now and then grows the table. The caller
+    // must not hold a bucket lock. node_hash(node) returns a node's hash.
+    template <typename NodeHash>
+    void note_insert(NodeHash node_hash) {
+        auto c = stripe().inserts.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (c % grow_check_interval == 0)
+            grow(node_hash);
+    }
+
+    template <typename NodeHash>
+    void grow(NodeHash node_hash) {
+        double target = count() / max_load_;
+        if (size() >= target)
+            return;
+        // Leave the splitting to whichever thread is at it, unless the
+        // table has fallen far behind
+        std::unique_lock<std::mutex> guard(split_lock_, std::defer_lock);
+        if (size() * 2 < target)
+            guard.lock();
+        else if (!guard.try_lock())
+            return;
+        for (unsigned k = 0; k != max_splits_per_check && size() < target; ++k)
+            split(node_hash);
+    }
+
+private:
+    struct __attribute__((aligned(128))) count_stripe {
+        std::atomic<int64_t> inserts;
+        std::atomic<int64_t> removes;
+    };
+
+    const size_t base_;
+    std::atomic<size_t> n_;
+    const double max_load_;
+    std::atomic<Bucket*> segments_[max_segments];
+    count_stripe stripes_[count_stripes] = {};
+    std::mutex split_lock_;
+
+    // Largest base << L not above n
+    size_t level_size_of(size_t n) const {
+        return base_ << (63 - __builtin_clzll(n / base_));
+    }
+    unsigned segment_of(size_t i) const {
+        return 64 - __builtin_clzll(i / base_);
+    }
+    count_stripe& stripe() {
+        return stripes_[TThread::id() % count_stripes];
+    }
+
+    // Splits the next bucket in order; split_lock_ must be held
+    template <typename NodeHash>
+    void split(NodeHash node_hash) {
+        size_t n = n_.load(std::memory_order_relaxed);
+        size_t level_size = level_size_of(n);
+        size_t from = n - level_size;
+        unsigned s = segment_of(n);
+        always_assert(s < max_segments, "linear_hash_buckets too large");
+        if (!segments_[s].load(std::memory_order_relaxed))
+            segments_[s].store(new Bucket[base_ << (s - 1)], std::memory_order_release);
+
+        Bucket& src = at(from);
+        Bucket& dst = at(n);
+        src.version.lock_exclusive();
+        dst.version.lock_exclusive();
+        n_.store(n + 1, std::memory_order_release);
+
+        src.split_to(dst, node_hash, [=] (size_t h) {
+            return h % (level_size * 2) == n;
+        });
+
+        src.version.inc_nonopaque();
+        dst.version.inc_nonopaque();
+        dst.version.unlock_exclusive();
+        src.version.unlock_exclusive();
+    }
+};
+
+// Bucket of the unordered indexes: a linked list of nodes. Node must have
+// a `next` pointer. find() may run unlocked; the other methods need the
+// bucket locked.
+template <typename Node, typename Version>
+struct chained_bucket {
+    // nodes per bucket above which the table grows
+    static constexpr double max_load = 1.0;
+
+    Node *head;
+    // this is the bucket version number, which is incremented on insert
+    // we use it to make sure that an unsuccessful key lookup will still be
+    // unsuccessful at commit time (because this will always be true if no
+    // new inserts have occurred in this bucket)
+    Version version;
+
+    chained_bucket() : head(nullptr), version(0) {}
+
+    // returns the first node for which match(node) is true
+    template <typename Match>
+    Node *find(size_t, Match match) const {
+        Node *curr = head;
+        while (curr && !match(curr))
+            curr = curr->next;
+        return curr;
+    }
+    // prefetches the first node find(h, ...) would look at
+    void prefetch(size_t) const {
+        __builtin_prefetch(head);
+    }
+    void insert(Node *node, size_t) {
+        node->next = head;
+        head = node;
+    }
+    // returns false if node is not in the bucket
+    bool erase(Node *node) {
+        Node **pprev = &head;
+        while (*pprev && *pprev != node)
+            pprev = &(*pprev)->next;
+        if (!*pprev)
+            return false;
+        *pprev = node->next;
+        return true;
+    }
+    // moves the nodes whose hash satisfies moves(hash) to the empty dst
+    template <typename NodeHash, typename Moves>
+    void split_to(chained_bucket& dst, NodeHash node_hash, Moves moves) {
+        Node **psrc = &head;
+        Node **pdst = &dst.head;
+        for (Node *node = head; node; ) {
+            Node *next = node->next;
+            if (moves(node_hash(node))) {
+                *psrc = next;
+                *pdst = node;
+                pdst = &node->next;
+            } else {
+                psrc = &node->next;
+            }
+            node = next;
+        }
+        *pdst = nullptr;
+    }
+};
+
+// Cache-line bucket of the unordered indexes, in the style of a Swiss
+// table: the first nslots nodes sit in slots tagged with a byte of their
+// hash, and the rest go on an overflow chain. A lookup compares all tags
+// in one word and dereferences only nodes whose tag matches, so a lookup
+// in a bucket without overflow touches the bucket's line and the matching
+// node, where a chain costs a dependent miss per node. Interface as for
+// chained_bucket.
+template <typename Node, typename Version>
+struct alignas(64) slot_bucket {
+    static constexpr unsigned nslots = 5;
+    // denser than chained_bucket: tags keep lookups to one node, and the
+    // table takes about as much memory per node
+    static constexpr double max_load = 4.0;
+
+    Version version;
+    // byte i is slots[i]'s tag, or 0 for an empty slot; written only with
+    // the bucket locked, after the slot it tags
+    std::atomic<uint64_t> tags;
+    Node *slots[nslots];
+    Node *head;
+
+    slot_bucket() : version(0), tags(0), slots(), head(nullptr) {}
+
+    // never 0; from the hash's high bits, which bucket indexes do not use
+    static uint8_t tag_of(size_t h) {
+        return uint8_t((h * 0x9e3779b97f4a7c15ULL) >> 56) | 1;
+    }
+    // bit 8 * i + 7 is set if byte i of t may equal tag; bytes above a real
+    // match can also be reported, so callers check the node
+    static uint64_t tag_matches(uint64_t t, uint8_t tag) {
+        constexpr uint64_t lows = 0x0101010101010101ULL;
+        constexpr uint64_t slot_mask = (uint64_t(1) << (8 * nslots)) - 1;
+        uint64_t x = t ^ (lows * tag);
+        return (x - lows) & ~x & (lows << 7) & slot_mask;
+    }
+
+    template <typename Match>
+    Node *find(size_t h, Match match) const {
+        uint64_t t = tags.load(std::memory_order_acquire);
+        for (uint64_t m = tag_matches(t, tag_of(h)); m; m &= m - 1) {
+            Node *node = slots[__builtin_ctzll(m) / 8];
+            if (node && match(node))
+                return node;
+        }
+        Node *curr = head;
+        while (curr && !match(curr))
+            curr = curr->next;
+        return curr;
+    }
+    void prefetch(size_t h) const {
+        uint64_t m = tag_matches(tags.load(std::memory_order_relaxed), tag_of(h));
+        __builtin_prefetch(m ? slots[__builtin_ctzll(m) / 8] : head);
+    }
+    void insert(Node *node, size_t h) {
+        uint64_t t = tags.load(std::memory_order_relaxed);
+        for (unsigned i = 0; i != nslots; ++i) {
+            if (!((t >> (8 * i)) & 0xFF)) {
+                slots[i] = node;
+                tags.store(t | (uint64_t(tag_of(h)) << (8 * i)), std::memory_order_release);
+                return;
+            }
+        }
+        node->next = head;
+        head = node;
+    }
+    bool erase(Node *node) {
+        uint64_t t = tags.load(std::memory_order_relaxed);
+        for (unsigned i = 0; i != nslots; ++i) {
+            if (((t >> (8 * i)) & 0xFF) && slots[i] == node) {
+                tags.store(t & ~(uint64_t(0xFF) << (8 * i)), std::memory_order_release);
+                slots[i] = nullptr;
+                return true;
+            }
+        }
+        Node **pprev = &head;
+        while (*pprev && *pprev != node)
+            pprev = &(*pprev)->next;
+        if (!*pprev)
+            return false;
+        *pprev = node->next;
+        return true;
+    }
+    template <typename NodeHash, typename Moves>
+    void split_to(slot_bucket& dst, NodeHash node_hash, Moves moves) {
+        for (unsigned i = 0; i != nslots; ++i) {
+            uint64_t t = tags.load(std::memory_order_relaxed);
+            if (((t >> (8 * i)) & 0xFF) && moves(node_hash(slots[i]))) {
+                dst.insert(slots[i], node_hash(slots[i]));
+                tags.store(t & ~(uint64_t(0xFF) << (8 * i)), std::memory_order_release);
+                slots[i] = nullptr;
+            }
+        }
+        Node **pprev = &head;
+        while (Node *node = *pprev) {
+            size_t h = node_hash(node);
+            if (moves(h)) {
+                *pprev = node->next;
+                dst.insert(node, h);
+            } else {
+                pprev = &node->next;
+            }
+        }
+    }
+};
+
 // unordered index implemented as hashtable
 template <typename K, typename V, typename DBParams>
 class unordered_index : public index_common<K, V, DBParams>, public TObject {
@@ -68,19 +394,14 @@ public:
     ~unordered_index() override {}
 
 private:
-    struct bucket_entry {
-        internal_elem *head;
-        // this is the bucket version number, which is incremented on insert
-        // we use it to make sure that an unsuccessful key lookup will still be
-        // unsuccessful at commit time (because this will always be true if no
-        // new inserts have occurred in this bucket)
-        bucket_version_type version;
-        bucket_entry() : head(nullptr), version(0) {}
-    };
+    typedef std::conditional_t<DBParams::SlotBuckets,
+                               slot_bucket<internal_elem, bucket_version_type>,
+                               chained_bucket<internal_elem, bucket_version_type>> bucket_entry;
+    static_assert(!DBParams::SlotBuckets || sizeof(bucket_entry) == 64,
+                  "slot_bucket should fill one cache line");
 
-    typedef std::vector<bucket_entry> MapType;
     // this is the hashtable itself, an array of bucket_entry's
-    MapType map_;
+    linear_hash_buckets<bucket_entry> buckets_;
     Hash hasher_;
     Pred pred_;
 
@@ -89,6 +410,8 @@ private:
     // used to mark whether a key is a bucket (for bucket version checks)
     // or a pointer (which will always have the lower 3 bits as 0)
     static constexpr uintptr_t bucket_bit = C::item_key_tag;
+    // keys multi_select_row prefetches before searching any of them
+    static constexpr unsigned multi_select_batch = 16;
 
 public:
     // split version helper stuff
@@ -104,18 +427,22 @@ public:
 
     // Main constructor
     unordered_index(size_t size, Hash h = Hash(), Pred p = Pred()) :
-            map_(), hasher_(h), pred_(p), key_gen_(0) {
-        map_.resize(size);
+            buckets_(size), hasher_(h), pred_(p), key_gen_(0) {
     }
 
     inline size_t hash(const key_type& k) const {
         return hasher_(k);
     }
+    // Grows as rows are inserted; see linear_hash_buckets
     inline size_t nbuckets() const {
-        return map_.size();
+        return buckets_.size();
+    }
+    // Nodes per bucket the table grows to stay under
+    static constexpr double max_load() {
+        return bucket_entry::max_load;
     }
     inline size_t find_bucket_idx(const key_type& k) const {
-        return hash(k) % nbuckets();
+        return buckets_.index(hash(k));
     }
 
     uint64_t gen_key() {
@@ -125,10 +452,10 @@ public:
 #if 0
     sel_return_type
     select_row(const key_type& k, RowAccess access) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
+        bucket_entry& buck = buckets_.at(find_bucket_idx(k));
         bucket_version_type buck_vers = buck.version;
         fence();
-        internal_elem *e = find_in_bucket(buck, k);
+        internal_elem *e = find_in_bucket(buck, k, hash(k));
 
         if (e != nullptr) {
             return select_row(reinterpret_cast<uintptr_t>(e), access);
@@ -143,21 +470,48 @@ public:
 
     sel_split_return_type
     select_split_row(const key_type& k, std::initializer_list<column_access_t> accesses) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
-        internal_elem *e = find_in_bucket(buck, k);
+        bucket_entry* buck;
+        bucket_version_type buck_vers;
+        internal_elem *e = find_observed(k, buck, buck_vers);
 
         if (e != nullptr) {
             return select_split_row(reinterpret_cast<uintptr_t>(e), accesses);
         } else {
-            if (!Sto::item(this, make_bucket_key(buck)).observe(buck_vers)) {
+            if (!Sto::item(this, make_bucket_key(*buck)).observe(buck_vers)) {
                 return { false, false, 0, UniRecordAccessor<V>(nullptr) };
             }
             return { true, false, 0, UniRecordAccessor<V>(nullptr) };
         }
     }
 
+    // Looks up nkeys keys at once, for select_split_row(rid, ...). Hashes
+    // a batch of keys and prefetches their buckets, then their first
+    // nodes, before searching any, so the misses overlap. rows[i] is set
+    // to the row id of keys[i], or to 0 if keys[i] is absent, in which
+    // case its bucket is observed as by select_split_row(key, ...).
+    // Returns false if the transaction must abort.
+    bool multi_select_row(const key_type* keys, size_t nkeys, uintptr_t* rows) {
+        size_t hashes[multi_select_batch];
+        for (size_t base = 0; base < nkeys; base += multi_select_batch) {
+            size_t nbatch = std::min(nkeys - base, size_t(multi_select_batch));
+            for (size_t i = 0; i != nbatch; ++i) {
+                hashes[i] = hash(keys[base + i]);
+                __builtin_prefetch(&buckets_.at(buckets_.index(hashes[i])));
+            }
+            for (size_t i = 0; i != nbatch; ++i)
+                buckets_.at(buckets_.index(hashes[i])).prefetch(hashes[i]);
+            for (size_t i = 0; i != nbatch; ++i) {
+                bucket_entry* buck;
+                bucket_version_type buck_vers;
+                internal_elem *e = find_observed(keys[base + i], hashes[i], buck, buck_vers);
+                rows[base + i] = reinterpret_cast<uintptr_t>(e);
+                if (!e && !Sto::item(this, make_bucket_key(*buck)).observe(buck_vers))
+                    return false;
+            }
+        }
+        return true;
+    }
+
 #if 0
     sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
@@ -252,10 +606,9 @@ public:
 
     ins_return_type
     insert_row(const key_type& k, value_type *vptr, bool overwrite = false) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-
-        buck.version.lock_exclusive();
-        internal_elem* e = find_in_bucket(buck, k);
+        size_t h = hash(k);
+        bucket_entry& buck = buckets_.lock(h);
+        internal_elem* e = find_in_bucket(buck, k, h);
 
         if (e) {
             buck.version.unlock_exclusive();
@@ -287,8 +640,7 @@ public:
         } else {
             // insert the new row to the table and take note of bucket version changes
             auto buck_vers_0 = bucket_version_type(buck.version.unlocked_value());
-            insert_in_bucket(buck, k, vptr, false);
-            internal_elem *new_head = buck.head;
+            internal_elem *new_head = insert_in_bucket(buck, k, h, vptr, false);
             auto buck_vers_1 = bucket_version_type(buck.version.unlocked_value());
 
             buck.version.unlock_exclusive();
@@ -297,6 +649,7 @@ public:
             auto bucket_item = Sto::item(this, make_bucket_key(buck));
             if (bucket_item.has_read())
                 bucket_item.update_read(buck_vers_0, buck_vers_1);
+            note_insert();
 
             auto item = Sto::item(this, item_key_t::row_item_key(new_head));
             // XXX adding write is probably unnecessary, am I right?
@@ -312,11 +665,9 @@ public:
     // until commit time
     del_return_type
     delete_row(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
-
-        internal_elem* e = find_in_bucket(buck, k);
+        bucket_entry* buck;
+        bucket_version_type buck_vers;
+        internal_elem* e = find_observed(k, buck, buck_vers);
         if (e) {
             auto item = Sto::item(this, item_key_t::row_item_key(e));
             bool valid = e->valid();
@@ -327,7 +678,7 @@ public:
                     // deleting something we inserted
                     _remove(e);
                     item.remove_read().remove_write().clear_flags(insert_bit | delete_bit);
-                    Sto::item(this, make_bucket_key(buck)).observe(buck_vers);
+                    Sto::item(this, make_bucket_key(*buck)).observe(buck_vers);
                     return { true, true };
                 }
                 assert(valid);
@@ -347,7 +698,7 @@ public:
             return { true, true };
         } else {
             // not found -- add observation of bucket version
-            bool ok = Sto::item(this, make_bucket_key(buck)).observe(buck_vers);
+            bool ok = Sto::item(this, make_bucket_key(*buck)).observe(buck_vers);
             if (!ok)
                 return del_abort;
             return { true, false };
@@ -356,26 +707,27 @@ public:
 
     // non-transactional methods
     value_type* nontrans_get(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        internal_elem* e = find_in_bucket(buck, k);
+        bucket_entry* buck;
+        bucket_version_type buck_vers;
+        internal_elem* e = find_observed(k, buck, buck_vers);
         if (e == nullptr)
             return nullptr;
         return &(e->row_container.row);
     }
 
     void nontrans_put(const key_type& k, const value_type& v) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        buck.version.lock_exclusive();
-        internal_elem *e = find_in_bucket(buck, k);
+        size_t h = hash(k);
+        bucket_entry& buck = buckets_.lock(h);
+        internal_elem *e = find_in_bucket(buck, k, h);
         if (e == nullptr) {
-            internal_elem *new_head = new internal_elem(k, v, true);
-            new_head->next = buck.head;
-            buck.head = new_head;
+            buck.insert(new internal_elem(k, v, true), h);
         } else {
             copy_row(e, &v);
             buck.version.inc_nonopaque();
         }
         buck.version.unlock_exclusive();
+        if (e == nullptr)
+            note_insert();
     }
 
     // TObject interface methods
@@ -497,62 +849,68 @@ private:
 
     // remove a k-v node during transactions (with locks)
     void _remove(internal_elem *el) {
-        bucket_entry& buck = map_[find_bucket_idx(el->key)];
-        buck.version.lock_exclusive();
-        internal_elem *prev = nullptr;
-        internal_elem *curr = buck.head;
-        while (curr != nullptr && curr != el) {
-            prev = curr;
-            curr = curr->next;
-        }
-        assert(curr);
-        if (prev != nullptr)
-            prev->next = curr->next;
-        else
-            buck.head = curr->next;
+        bucket_entry& buck = buckets_.lock(hash(el->key));
+        bool found = buck.erase(el);
+        assert(found);
+        (void)found;
         buck.version.unlock_exclusive();
-        Transaction::rcu_delete(curr);
+        buckets_.note_remove();
+        Transaction::rcu_delete(el);
     }
     // non-transactional remove by key
     bool remove(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        buck.version.lock_exclusive();
-        internal_elem *prev = nullptr;
-        internal_elem *curr = buck.head;
-        while (curr != nullptr && !pred_(curr->key, k)) {
-            prev = curr;
-            curr = curr->next;
-        }
+        size_t h = hash(k);
+        bucket_entry& buck = buckets_.lock(h);
+        internal_elem *curr = find_in_bucket(buck, k, h);
         if (curr == nullptr) {
             buck.version.unlock_exclusive();
             return false;
         }
-        if (prev != nullptr)
-            prev->next = curr->next;
-        else
-            buck.head = curr->next;
+        buck.erase(curr);
         buck.version.unlock_exclusive();
+        buckets_.note_remove();
         delete curr;
         return true;
     }
-    // insert a k-v node to a bucket
-    void insert_in_bucket(bucket_entry& buck, const key_type& k, const value_type *v, bool valid) {
+    // insert a k-v node to a bucket; h is hash(k)
+    internal_elem *insert_in_bucket(bucket_entry& buck, const key_type& k, size_t h, const value_type *v, bool valid) {
         assert(buck.version.is_locked());
 
         internal_elem *new_head = new internal_elem(k, v ? *v : value_type(), valid);
-        internal_elem *curr_head = buck.head;
-
-        new_head->next = curr_head;
-        buck.head = new_head;
+        buck.insert(new_head, h);
 
         buck.version.inc_nonopaque();
+        return new_head;
+    }
+    // find a key's k-v node (internal_elem) within a bucket; h is hash(k)
+    internal_elem *find_in_bucket(const bucket_entry& buck, const key_type& k, size_t h) {
+        return buck.find(h, [&] (const internal_elem *e) { return pred_(e->key, k); });
+    }
+    // find a key's k-v node without locking, also returning its bucket and
+    // the bucket version read before the search. A miss is retried if the
+    // bucket was locked or changed meanwhile, since a split may be moving
+    // the key away, and only bumps the version once it is done.
+    internal_elem *find_observed(const key_type& k, bucket_entry*& buck, bucket_version_type& buck_vers) {
+        return find_observed(k, hash(k), buck, buck_vers);
+    }
+    internal_elem *find_observed(const key_type& k, size_t h, bucket_entry*& buck, bucket_version_type& buck_vers) {
+        while (true) {
+            size_t idx = buckets_.index(h);
+            buck = &buckets_.at(idx);
+            buck_vers = buck->version;
+            fence();
+            internal_elem *e = find_in_bucket(*buck, k, h);
+            fence();
+            if (e)
+                return e;
+            if (!buck_vers.is_locked() && buck->version.value() == buck_vers.value()
+                && buckets_.index(h) == idx)
+                return nullptr;
+            relax_fence();
+        }
     }
-    // find a key's k-v node (internal_elem) within a bucket
-    internal_elem *find_in_bucket(const bucket_entry& buck, const key_type& k) {
-        internal_elem *curr = buck.head;
-        while (curr && !pred_(curr->key, k))
-            curr = curr->next;
-        return curr;
+    void note_insert() {
+        buckets_.note_insert([this] (internal_elem *e) { return hash(e->key); });
     }
 
     static bool is_phantom(internal_elem *e, const TransItem& item) {
@@ -665,27 +1023,21 @@ public:
     ~mvcc_unordered_index() override {}
 
 private:
-    struct bucket_entry {
-        KVNode *head;
-        // this is the bucket version number, which is incremented on insert
-        // we use it to make sure that an unsuccessful key lookup will still be
-        // unsuccessful at commit time (because this will always be true if no
-        // new inserts have occurred in this bucket)
-        bucket_version_type version;
-        bucket_entry() : head(nullptr), version(0) {}
-    };
+    typedef chained_bucket<KVNode, bucket_version_type> bucket_entry;
 
-    typedef std::vector<bucket_entry> MapType;
     // this is the hashtable itself, an array of bucket_entry's
-    MapType map_;
+    linear_hash_buckets<bucket_entry> buckets_;
     Hash hasher_;
     Pred pred_;
 
     uint64_t key_gen_;
+    unsigned gc_table_id_ = 0;
 
     // used to mark whether a key is a bucket (for bucket version checks)
     // or a pointer (which will always have the lower 3 bits as 0)
     static constexpr uintptr_t bucket_bit = C::item_key_tag;
+    // keys multi_select_row prefetches before searching any of them
+    static constexpr unsigned multi_select_batch = 16;
 
 public:
     // split version helper stuff
@@ -701,31 +1053,41 @@ public:
 
     // Main constructor
     mvcc_unordered_index(size_t size, Hash h = Hash(), Pred p = Pred()) :
-            map_(), hasher_(h), pred_(p), key_gen_(0) {
-        map_.resize(size);
+            buckets_(size), hasher_(h), pred_(p), key_gen_(0) {
     }
 
     inline size_t hash(const key_type& k) const {
         return hasher_(k);
     }
+    // Grows as rows are inserted; see linear_hash_buckets
     inline size_t nbuckets() const {
-        return map_.size();
+        return buckets_.size();
+    }
+    // Nodes per bucket the table grows to stay under
+    static constexpr double max_load() {
+        return bucket_entry::max_load;
     }
     inline size_t find_bucket_idx(const key_type& k) const {
-        return hash(k) % nbuckets();
+        return buckets_.index(hash(k));
     }
 
     uint64_t gen_key() {
         return fetch_and_add(&key_gen_, 1);
     }
 
+    // Names this index for MvRegistry's per-table history accounting.
+    // Rows inserted afterwards are counted under it.
+    void gc_table(const std::string& name) {
+        gc_table_id_ = MvRegistry::table_id(name);
+    }
+
 #if 0
     sel_return_type
     select_row(const key_type& k, RowAccess access) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
+        bucket_entry& buck = buckets_.at(find_bucket_idx(k));
         bucket_version_type buck_vers = buck.version;
         fence();
-        internal_elem *e = find_in_bucket(buck, k);
+        internal_elem *e = find_in_bucket(buck, k, hash(k));
 
         if (e != nullptr) {
             return select_row(reinterpret_cast<uintptr_t>(e), access);
@@ -739,10 +1101,10 @@ public:
 
     sel_return_type
     select_row(const key_type& k, std::initializer_list<column_access_t> accesses) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
+        bucket_entry& buck = buckets_.at(find_bucket_idx(k));
         bucket_version_type buck_vers = buck.version;
         fence();
-        internal_elem *e = find_in_bucket(buck, k);
+        internal_elem *e = find_in_bucket(buck, k, hash(k));
 
         if (e != nullptr) {
             return select_row(reinterpret_cast<uintptr_t>(e), accesses);
@@ -793,17 +1155,16 @@ public:
     // Split version select row
     sel_split_return_type
     select_split_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
-        bucket_entry& buck = map_[find_bucket_idx(key)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
-        KVNode *n = find_in_bucket(buck, key);
+        bucket_entry* buck;
+        bucket_version_type buck_vers;
+        KVNode *n = find_observed(key, buck, buck_vers);
 
         if (n) {
             auto e = &n->elem;
             return select_splits(reinterpret_cast<uintptr_t>(e), accesses);
         } else {
             return {
-                Sto::item(this, make_bucket_key(buck)).observe(buck_vers),
+                Sto::mvcc_ro() || Sto::item(this, make_bucket_key(*buck)).observe(buck_vers),
                 false,
                 0,
                 SplitRecordAccessor<V>({ nullptr })
@@ -811,6 +1172,37 @@ public:
         }
     }
 
+    // Split version select row, by a row id from multi_select_row
+    sel_split_return_type
+    select_split_row(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
+        return select_splits(rid, accesses);
+    }
+
+    // Looks up nkeys keys at once; see unordered_index. Snapshot reads
+    // skip observing the buckets of absent keys.
+    bool multi_select_row(const key_type* keys, size_t nkeys, uintptr_t* rows) {
+        size_t hashes[multi_select_batch];
+        for (size_t base = 0; base < nkeys; base += multi_select_batch) {
+            size_t nbatch = std::min(nkeys - base, size_t(multi_select_batch));
+            for (size_t i = 0; i != nbatch; ++i) {
+                hashes[i] = hash(keys[base + i]);
+                __builtin_prefetch(&buckets_.at(buckets_.index(hashes[i])));
+            }
+            for (size_t i = 0; i != nbatch; ++i)
+                buckets_.at(buckets_.index(hashes[i])).prefetch(hashes[i]);
+            for (size_t i = 0; i != nbatch; ++i) {
+                bucket_entry* buck;
+                bucket_version_type buck_vers;
+                KVNode *n = find_observed(keys[base + i], hashes[i], buck, buck_vers);
+                rows[base + i] = n ? reinterpret_cast<uintptr_t>(&n->elem) : 0;
+                if (!n && !Sto::mvcc_ro()
+                    && !Sto::item(this, make_bucket_key(*buck)).observe(buck_vers))
+                    return false;
+            }
+        }
+        return true;
+    }
+
     sel_split_return_type
     select_splits(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
         using split_params = SplitParams<value_type>;
@@ -839,16 +1231,15 @@ public:
 
     ins_return_type
     insert_row(const key_type& k, value_type *vptr, bool overwrite = false) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-
-        buck.version.lock_exclusive();
-        KVNode* n = find_in_bucket(buck, k);
+        size_t khash = hash(k);
+        bucket_entry& buck = buckets_.lock(khash);
+        KVNode* n = find_in_bucket(buck, k, khash);
+        bool inserted = !n;
 
         if (!n) {
             // insert the new row to the table and take note of bucket version changes
             auto buck_vers_0 = bucket_version_type(buck.version.unlocked_value());
-            insert_in_bucket(buck, k);
-            KVNode* new_head = buck.head;
+            KVNode* new_head = insert_in_bucket(buck, k, khash);
             auto buck_vers_1 = bucket_version_type(buck.version.unlocked_value());
 
             // update bucket version in the read set (if any) since it's changed by ourselves
@@ -862,6 +1253,8 @@ public:
 
         auto e = &n->elem;
         buck.version.unlock_exclusive();
+        if (inserted)
+            note_insert();
         auto row_item = Sto::item(this, item_key_t(e, 0));
         auto h = e->template chain_at<0>()->find(txn_read_tid());
         if (is_phantom(h, row_item)) {
@@ -900,11 +1293,9 @@ public:
     // until commit time
     del_return_type
     delete_row(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
-
-        KVNode* n = find_in_bucket(buck, k);
+        bucket_entry* buck;
+        bucket_version_type buck_vers;
+        KVNode* n = find_observed(k, buck, buck_vers);
         if (n) {
             auto e = &n->elem;
             // Use cell 0 to probe for existence of the row.
@@ -937,7 +1328,7 @@ public:
             return { true, true };
         } else {
             // not found -- add observation of bucket version
-            bool ok = Sto::item(this, make_bucket_key(buck)).observe(buck_vers);
+            bool ok = Sto::item(this, make_bucket_key(*buck)).observe(buck_vers);
             if (!ok)
                 return del_abort;
             return { true, false };
@@ -946,8 +1337,9 @@ public:
 
     // non-transactional methods
     bool nontrans_get(const key_type& k, value_type* value_out) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        KVNode* n = find_in_bucket(buck, k);
+        bucket_entry* buck;
+        bucket_version_type buck_vers;
+        KVNode* n = find_observed(k, buck, buck_vers);
         if (n == nullptr) {
             return false;
         } else {
@@ -958,17 +1350,19 @@ public:
     }
 
     void nontrans_put(const key_type& k, const value_type& v) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        buck.version.lock_exclusive();
-        KVNode* n = find_in_bucket(buck, k);
+        size_t h = hash(k);
+        bucket_entry& buck = buckets_.lock(h);
+        KVNode* n = find_in_bucket(buck, k, h);
+        bool inserted = !n;
         if (n == nullptr) {
-            KVNode* new_head = new KVNode(this, k);
-            new_head->next = buck.head;
-            buck.head = new_head;
-            n = new_head;
+            n = new KVNode(this, k);
+            n->elem.gc_table(gc_table_id_);
+            buck.insert(n, h);
         }
         MvSplitAccessAll::run_nontrans_put(v, &n->elem);
         buck.version.unlock_exclusive();
+        if (inserted)
+            note_insert();
     }
 
     template <typename TSplit>
@@ -1025,41 +1419,26 @@ public:
 private:
     // remove a k-v node during transactions (with locks)
     void _remove(KVNode *el) {
-        bucket_entry& buck = map_[find_bucket_idx(el->elem.key)];
-        buck.version.lock_exclusive();
-        KVNode *prev = nullptr;
-        KVNode *curr = buck.head;
-        while (curr != nullptr && curr != el) {
-            prev = curr;
-            curr = curr->next;
-        }
-        assert(curr);
-        if (prev != nullptr)
-            prev->next = curr->next;
-        else
-            buck.head = curr->next;
+        bucket_entry& buck = buckets_.lock(hash(el->elem.key));
+        bool found = buck.erase(el);
+        assert(found);
+        (void)found;
         buck.version.unlock_exclusive();
-        Transaction::rcu_delete(curr);
+        buckets_.note_remove();
+        Transaction::rcu_delete(el);
     }
     // non-transactional remove by key
     bool remove(const key_type& k) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        buck.version.lock_exclusive();
-        KVNode *prev = nullptr;
-        KVNode *curr = buck.head;
-        while (curr != nullptr && !pred_(curr->elem.key, k)) {
-            prev = curr;
-            curr = curr->next;
-        }
+        size_t h = hash(k);
+        bucket_entry& buck = buckets_.lock(h);
+        KVNode *curr = find_in_bucket(buck, k, h);
         if (curr == nullptr) {
             buck.version.unlock_exclusive();
             return false;
         }
-        if (prev != nullptr)
-            prev->next = curr->next;
-        else
-            buck.head = curr->next;
+        buck.erase(curr);
         buck.version.unlock_exclusive();
+        buckets_.note_remove();
         delete curr;
         return true;
     }
@@ -1071,8 +1450,7 @@ private:
         if (obj->find_latest(false) == hp) {
             auto el = KVNode::from_chain(obj);
             auto table = reinterpret_cast<mvcc_unordered_index<K, V, DBParams>*>(el->elem.table);
-            bucket_entry& buck = table->map_[table->find_bucket_idx(el->elem.key)];
-            buck.version.lock_exclusive();
+            bucket_entry& buck = table->buckets_.lock(table->hash(el->elem.key));
             KVNode** pprev = &buck.head;
             while (*pprev && *pprev != el) {
                 pprev = &(*pprev)->next;
@@ -1082,6 +1460,7 @@ private:
             if (obj->find_latest(true) == hp) {
                 *pprev = el->next;
                 buck.version.unlock_exclusive();
+                table->buckets_.note_remove();
                 Transaction::rcu_call(gc_internal_elem, el);
             } else {
                 hp->status_unpoisoned();
@@ -1091,28 +1470,47 @@ private:
     }
 
     static void gc_internal_elem(void* el_ptr) {
-        auto el = reinterpret_cast<internal_elem*>(el_ptr);
+        auto el = reinterpret_cast<KVNode*>(el_ptr);
         delete el;
     }
 
-    // insert a k-v node to a bucket
-    void insert_in_bucket(bucket_entry& buck, const key_type& k) {
+    // insert a k-v node to a bucket; h is hash(k)
+    KVNode *insert_in_bucket(bucket_entry& buck, const key_type& k, size_t h) {
         assert(buck.version.is_locked());
 
         auto new_head = new KVNode(this, k);
-        auto curr_head = buck.head;
-
-        new_head->next = curr_head;
-        buck.head = new_head;
+        new_head->elem.gc_table(gc_table_id_);
+        buck.insert(new_head, h);
 
         buck.version.inc_nonopaque();
+        return new_head;
     }
-    // find a key's k-v node within a bucket
-    KVNode *find_in_bucket(const bucket_entry& buck, const key_type& k) {
-        auto curr = buck.head;
-        while (curr && !pred_(curr->elem.key, k))
-            curr = curr->next;
-        return curr;
+    // find a key's k-v node within a bucket; h is hash(k)
+    KVNode *find_in_bucket(const bucket_entry& buck, const key_type& k, size_t h) {
+        return buck.find(h, [&] (const KVNode *n) { return pred_(n->elem.key, k); });
+    }
+    // find a key's k-v node without locking; see unordered_index
+    KVNode *find_observed(const key_type& k, bucket_entry*& buck, bucket_version_type& buck_vers) {
+        return find_observed(k, hash(k), buck, buck_vers);
+    }
+    KVNode *find_observed(const key_type& k, size_t h, bucket_entry*& buck, bucket_version_type& buck_vers) {
+        while (true) {
+            size_t idx = buckets_.index(h);
+            buck = &buckets_.at(idx);
+            buck_vers = buck->version;
+            fence();
+            KVNode *n = find_in_bucket(*buck, k, h);
+            fence();
+            if (n)
+                return n;
+            if (!buck_vers.is_locked() && buck->version.value() == buck_vers.value()
+                && buckets_.index(h) == idx)
+                return nullptr;
+            relax_fence();
+        }
+    }
+    void note_insert() {
+        buckets_.note_insert([this] (KVNode *n) { return hash(n->elem.key); });
     }
 
     template <typename T>
@@ -0,0 +1,110 @@
+// Microbenchmark for MVCC delta flattening: builds chains of commutative
+// deltas on many integer boxes, then times flattening each chain once.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "clp.h"
+#include "Sto.hh"
+#include "TMvBox.hh"
+
+enum { opt_nobjs = 1, opt_chain, opt_rounds };
+
+struct cmd_params {
+    unsigned num_objects;
+    unsigned chain_length;
+    unsigned rounds;
+
+    cmd_params() : num_objects(1000),
+                   chain_length(MvObject<int64_t>::gc_flattening_length),
+                   rounds(10) {}
+};
+
+static const Clp_Option options[] = {
+    { "objects",  'n', opt_nobjs,  Clp_ValUnsigned, Clp_Optional },
+    { "chain",    'c', opt_chain,  Clp_ValUnsigned, Clp_Optional },
+    { "rounds",   'r', opt_rounds, Clp_ValUnsigned, Clp_Optional },
+};
+
+// Returns the seconds spent flattening one chain per box
+double run_round(const cmd_params& p) {
+    std::vector<std::unique_ptr<TMvCommuteIntegerBox>> boxes;
+    for (unsigned i = 0; i != p.num_objects; ++i) {
+        boxes.emplace_back(new TMvCommuteIntegerBox);
+        boxes.back()->nontrans_write(0);
+    }
+    for (unsigned d = 0; d != p.chain_length; ++d) {
+        RWTRANSACTION {
+            for (auto& b : boxes)
+                b->increment(d + 1);
+        } RETRY(true);
+    }
+
+    std::vector<MvHistory<int64_t>*> heads;
+    for (auto& b : boxes)
+        heads.push_back(TMvBoxAccess::latest(*b, false));
+
+    auto start = std::chrono::steady_clock::now();
+    int64_t sum = 0;
+    for (auto h : heads)
+        sum += h->value();
+    auto end = std::chrono::steady_clock::now();
+
+    int64_t expected = int64_t(p.chain_length) * (p.chain_length + 1) / 2 * p.num_objects;
+    always_assert(sum == expected, "flattened to the wrong value");
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, const char * const *argv) {
+    cmd_params p;
+
+    Sto::global_init();
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    int ret_code = 0;
+    int opt;
+    bool clp_stop = false;
+    while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
+        switch (opt) {
+        case opt_nobjs:
+            p.num_objects = clp->val.u;
+            break;
+        case opt_chain:
+            p.chain_length = clp->val.u;
+            break;
+        case opt_rounds:
+            p.rounds = clp->val.u;
+            break;
+        default:
+            ret_code = 1;
+            clp_stop = true;
+            break;
+        }
+    }
+    Clp_DeleteParser(clp);
+    if (ret_code != 0)
+        return ret_code;
+
+    // the chains must not be flattened while they are built
+    always_assert(p.chain_length <= unsigned(MvObject<int64_t>::gc_flattening_length),
+                  "chain longer than gc_flattening_length");
+
+    TThread::set_id(0);
+    std::cout << "Objects: " << p.num_objects << ", chain length: " << p.chain_length
+              << ", batched flatten: " << (MVCC_FLATTEN_BATCH ? "on" : "off") << std::endl;
+
+    double total = 0;
+    for (unsigned r = 0; r != p.rounds; ++r)
+        total += run_round(p);
+
+    double ndeltas = double(p.num_objects) * p.chain_length * p.rounds;
+    printf("Flattened deltas:     %.0f\n", ndeltas);
+    printf("Flatten time:         %.3f ms\n", total * 1000);
+    printf("Deltas/sec:           %.3f M\n", ndeltas / total / 1e6);
+    printf("ns/delta:             %.2f\n", total * 1e9 / ndeltas);
+
+    std::thread advancer;
+    Transaction::rcu_release_all(advancer, 1);
+    return 0;
+}
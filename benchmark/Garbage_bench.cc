@@ -7,15 +7,17 @@
 
 double db_params::constants::processor_tsc_frequency;
 
-enum { opt_dbid = 1, opt_nthrs, opt_time, opt_dbsz };
+enum { opt_dbid = 1, opt_nthrs, opt_time, opt_dbsz, opt_pool };
 
 struct cmd_params {
     db_params::db_params_id dbid;
     size_t db_size;
     int num_threads;
     double time_limit;
+    bool history_pool;
 
-    cmd_params() : dbid(db_params::db_params_id::Default), db_size(256), num_threads(1), time_limit(10.0) {}
+    cmd_params() : dbid(db_params::db_params_id::Default), db_size(256), num_threads(1), time_limit(10.0),
+                   history_pool(MvHistoryAllocator::enabled()) {}
 };
 
 static const Clp_Option options[] = {
@@ -23,6 +25,7 @@ static const Clp_Option options[] = {
     { "nthreads",   't', opt_nthrs, Clp_ValInt,     Clp_Optional },
     { "time",       'l', opt_time,  Clp_ValDouble,  Clp_Optional },
     { "dbsize",     'z', opt_dbsz,  Clp_ValInt,     Clp_Optional },
+    { "pool",       'p', opt_pool,  Clp_NoVal,      Clp_Negate | Clp_Optional },
 };
 
 template <typename DBParams>
@@ -37,6 +40,7 @@ void execute(cmd_params& p) {
     auto nthreads = p.num_threads;
     auto time_limit = p.time_limit;
     std::cout << "Number of threads: " << nthreads << std::endl;
+    std::cout << "MVCC history pool: " << (MvHistoryAllocator::enabled() ? "on" : "off") << std::endl;
 
     r_type_nopred r_nopred(nthreads, time_limit, db_nopred);
 
@@ -73,6 +77,16 @@ void execute(cmd_params& p) {
 #else
     (void) total_reqs, (void) total_impls;
 #endif
+    if (DBParams::MVCC && MvHistoryAllocator::enabled()) {
+        auto as = MvHistoryAllocator::stats();
+        printf("History pool hits:    %lu\n", as.hits);
+        printf("History pool misses:  %lu\n", as.misses);
+        printf("History pool hit rate: %.2lf%%\n",
+               100. * as.hits / std::max(as.hits + as.misses, uint64_t(1)));
+        printf("History depot moves:  %lu\n", as.depot_moves);
+        printf("History bytes in use: %ld\n", as.bytes_in_use);
+        printf("History slab bytes:   %lu\n", as.slab_bytes);
+    }
 }
 
 int main(int argc, const char * const *argv) {
@@ -105,6 +119,9 @@ int main(int argc, const char * const *argv) {
         case opt_time:
             p.time_limit = clp->val.d;
             break;
+        case opt_pool:
+            p.history_pool = !clp->negated;
+            break;
         default:
             ret_code = 1;
             clp_stop = true;
@@ -119,6 +136,7 @@ int main(int argc, const char * const *argv) {
     if (freq ==  0.0)
         return -1;
     db_params::constants::processor_tsc_frequency = freq;
+    MvHistoryAllocator::set_enabled(p.history_pool);
 
     switch (p.dbid) {
         case db_params::db_params_id::MVCC:
@@ -22,7 +22,8 @@ enum {
     opt_perf,
     opt_dump,
     opt_gran,
-    opt_insm
+    opt_insm,
+    opt_empty
 };
 
 static const Clp_Option options[] = {
@@ -40,7 +41,8 @@ static const Clp_Option options[] = {
     { "perf",        'p', opt_perf,   Clp_NoVal,       Clp_Negate | Clp_Optional },
     { "dump",        'd', opt_dump,   Clp_NoVal,       Clp_Negate | Clp_Optional },
     { "granule",     'g', opt_gran,   Clp_ValUnsigned, Clp_Optional },
-    { "measure",     'm', opt_insm,   Clp_NoVal,       Clp_Negate | Clp_Optional }
+    { "measure",     'm', opt_insm,   Clp_NoVal,       Clp_Negate | Clp_Optional },
+    { "empty",       0,   opt_empty,  Clp_NoVal,       Clp_Negate | Clp_Optional }
 };
 
 inline void print_usage(const char *prog) {
@@ -62,7 +64,8 @@ inline void print_usage(const char *prog) {
        << "  --perf (-p), spawn perf profiler after the benchmark starts executing, default off" << std::endl
        << "  --dump (-d), dump the trace of all generated transactions (not functional for now)" << std::endl
        << "  --granule (-g) select the granularity of concurrency control" << std::endl
-       << "  --measure (-m), enable instantaneous measurements of throughput and optimistic read rates, default off" << std::endl;
+       << "  --measure (-m), enable instantaneous measurements of throughput and optimistic read rates, default off" << std::endl
+       << "  --empty, run empty transactions to measure fixed start+commit cost (uses --nthreads and --time only)" << std::endl;
 
     std::cout << ss.str() << std::flush;
 }
@@ -145,6 +148,7 @@ int main(int argc, const char *argv[]) {
     params.profiler = false;
     params.granules = 1;
     params.ins_measure = false;
+    bool empty_txns = false;
 
     Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
 
@@ -206,6 +210,9 @@ int main(int argc, const char *argv[]) {
             case opt_insm:
                 params.ins_measure = !clp->negated;
                 break;
+            case opt_empty:
+                empty_txns = !clp->negated;
+                break;
             default:
                 print_usage(argv[0]);
                 ret = 1;
@@ -227,6 +234,12 @@ int main(int argc, const char *argv[]) {
     db_params::constants::processor_tsc_frequency = freq;
     params.proc_frequency_hz = (uint64_t)(freq * db_params::constants::billion);
 
+    if (empty_txns) {
+        ubench::run_empty_txn_bench();
+        Transaction::print_stats();
+        return 0;
+    }
+
     always_assert(params.datatype == ubench::DsType::masstree, "Only Masstree is currently supported");
 
     switch (params.granules) {
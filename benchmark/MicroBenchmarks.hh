@@ -170,6 +170,9 @@ public:
 
     inline void execute();
     inline uint64_t run_benchmark(uint64_t start_tsc);
+#if STO_TSC_PROFILE
+    void report_commit_phases(uint64_t num_commits);
+#endif
 
     void workload_init(int thread_id) {
         wl_gen.workload_init(thread_id);
@@ -217,8 +220,33 @@ void Tester<DSImpl, WLImpl>::execute() {
     profiler.start(Profiler::perf_mode::record);
     auto num_commits = run_benchmark(profiler.start_timestamp());
     profiler.finish(num_commits);
+#if STO_TSC_PROFILE
+    report_commit_phases(num_commits);
+#endif
 }
 
+#if STO_TSC_PROFILE
+// Cycles per committed transaction spent in each commit phase. Build with
+// TSC_PROFILE=1 and TSET_INDEX=0/1 to compare the full tset scan against the
+// read/write index arrays.
+template <typename DSImpl, typename WLImpl>
+void Tester<DSImpl, WLImpl>::report_commit_phases(uint64_t num_commits) {
+    if (num_commits == 0)
+        return;
+    auto tcs = Transaction::tc_counters_combined();
+    auto per_commit = [&] (int name) {
+        return (double) tcs.timing_counter(name) / num_commits;
+    };
+    std::cout << "Commit phases (cycles/commit, tset index "
+              << (STO_TSET_INDEX ? "on" : "off") << "):" << std::endl
+              << "  lock: " << per_commit(tc_commit_lock) << std::endl
+              << "  check: " << per_commit(tc_commit_check) << std::endl
+              << "  install: " << per_commit(tc_commit_install) << std::endl
+              << "  cleanup: " << per_commit(tc_cleanup) << std::endl
+              << "  total commit: " << per_commit(tc_commit) << std::endl;
+}
+#endif
+
 template <typename DSImpl, typename WLImpl>
 uint64_t Tester<DSImpl, WLImpl>::run_benchmark(uint64_t start_tsc) {
     std::vector<std::thread> thread_pool;
@@ -455,5 +483,45 @@ using MtZipfTesterDefault = TesterSelector<DsType::masstree, WLZipfRW<wl_default
 template <int G, typename DBParams>
 using MtZipfTesterMeasure = TesterSelector<DsType::masstree, WLZipfRW<wl_measurement_params<G>>, DBParams>;
 
+// Fixed per-transaction cost: each thread runs transactions that touch no
+// data, so the loop measures only start() plus commit.
+inline void run_empty_txn_bench() {
+    std::vector<std::thread> thread_pool;
+    std::vector<uint64_t> txn_cnts(params.nthreads, 0);
+    uint64_t ticks_to_wait = (uint64_t)(params.time_limit * (double)(params.proc_frequency_hz));
+
+    std::cout << "Running empty transactions" << std::endl;
+    uint64_t start_tsc = read_tsc();
+    for (auto i = 0u; i < params.nthreads; ++i) {
+        thread_pool.emplace_back([&, i] () {
+            TThread::set_id(i);
+            set_affinity(i);
+            uint64_t n = 0;
+            while (true) {
+                for (int j = 0; j < 1024; ++j) {
+                    Sto::start_transaction();
+                    always_assert(Sto::try_commit(), "empty transaction aborted");
+                }
+                n += 1024;
+                if (read_tsc() - start_tsc >= ticks_to_wait)
+                    break;
+            }
+            txn_cnts[i] = n;
+        });
+    }
+    for (auto& t : thread_pool)
+        t.join();
+    uint64_t elapsed = read_tsc() - start_tsc;
+
+    uint64_t total = 0;
+    for (auto n : txn_cnts)
+        total += n;
+    double secs = (double) elapsed / params.proc_frequency_hz;
+    std::cout << "Empty transactions: " << total << " in " << secs << " s, "
+              << (total / secs) << " txns/sec" << std::endl
+              << "  start+commit: " << ((double) elapsed * params.nthreads / total)
+              << " cycles/txn per thread" << std::endl;
+}
+
 };
 
@@ -28,6 +28,14 @@ const Clp_Option options[] = {
         { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "verbose",      'v', opt_verb,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "mix",          'm', opt_mix,   Clp_ValInt,    Clp_Optional },
+        { "rcu-helpers",  0,   opt_rcuh,  Clp_ValInt,    Clp_Optional },
+        { "gc-mode",      0,   opt_gcmode, Clp_ValString, Clp_Optional },
+        { "latency-json", 0,   opt_ljson, Clp_ValString, Clp_Optional },
+        { "validate-every", 0, opt_vevery, Clp_ValUnsigned, Clp_Optional },
+        { "validate-checkpoints", 0, opt_vckpt, Clp_NoVal, Clp_Negate | Clp_Optional },
+        { "mvcc-collector", 0, opt_mvgc,  Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "mvcc-flatteners", 0, opt_mvflat, Clp_ValUnsigned, Clp_Optional },
+        { "mvcc-chain-sample", 0, opt_mvsample, Clp_ValUnsigned, Clp_Optional },
 };
 
 const char* workload_mix_names[] = { "Full", "NO-only", "NO+P-only" };
@@ -42,7 +50,8 @@ void print_usage(const char *argv_0) {
     ss << "Usage of " << std::string(argv_0) << ":" << std::endl
        << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
        << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
-       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode" << std::endl
+       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode," << std::endl
+       << "      mvcclease (MVCC whose reads lease versions instead of writing their rtids)" << std::endl
        << "  --nwarehouses=<NUM> (or -w<NUM>)" << std::endl
        << "    Specify the number of warehouses (default 1)." << std::endl
        << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
@@ -57,6 +66,27 @@ void print_usage(const char *argv_0) {
        << "    Enable garbage collection (default false)." << std::endl
        << "  --gc-rate=<NUM> (or -r<NUM>)" << std::endl
        << "    Number of microseconds between GC epochs. Defaults to 100000." << std::endl
+       << "  --gc-mode=<fixed|adaptive>" << std::endl
+       << "    With adaptive, tune the GC epoch length at runtime from RCU backlog, MVCC chain length" << std::endl
+       << "    and commit rate, starting from --gc-rate (default fixed)." << std::endl
+       << "  --rcu-helpers=<NUM>" << std::endl
+       << "    With --gc, run RCU callbacks on NUM helper threads per NUMA node instead of the workers (default 0)." << std::endl
+       << "  --mvcc-collector" << std::endl
+       << "    With --gc and an MVCC dbid, trim and flatten version chains on a background collector thread," << std::endl
+       << "    and print retained history per table after the run (default off)." << std::endl
+       << "  --mvcc-flatteners=<NUM>" << std::endl
+       << "    With --gc and an MVCC dbid, flatten hot runs of commutative deltas on NUM worker threads" << std::endl
+       << "    ahead of the readers (default 0)." << std::endl
+       << "  --mvcc-chain-sample=<NUM>" << std::endl
+       << "    With an MVCC dbid, sample version chain and delta run lengths per table at every NUM-th" << std::endl
+       << "    installed version on each thread (default 0, off)." << std::endl
+       << "  --latency-json=<FILE>" << std::endl
+       << "    Write per-thread and combined latency histograms (execution, commit phases, end-to-end;" << std::endl
+       << "    needs a TSC_PROFILE=1 build) and MVCC per-table history statistics to FILE as JSON." << std::endl
+       << "  --validate-every=<NUM>" << std::endl
+       << "    Revalidate the OCC read set after every NUM new reads and abort early if stale (default 0, off)." << std::endl
+       << "  --validate-checkpoints" << std::endl
+       << "    Also revalidate at the checkpoints in long transactions (default off)." << std::endl
        << "  --node (or -n)" << std::endl
        << "    Enable node tracking (default false)." << std::endl
        << "  --commute (or -x)" << std::endl
@@ -207,6 +237,16 @@ int main(int argc, const char *const *argv) {
             ret_code = tpcc_m(argc, argv);
         }
         break;
+    case db_params_id::MVCCLease:
+        if (node_tracking) {
+            std::cerr << "Warning: node tracking option ignored." << std::endl;
+        }
+        if (enable_commute) {
+            ret_code = tpcc_mlc(argc, argv);
+        } else {
+            ret_code = tpcc_ml(argc, argv);
+        }
+        break;
     default:
         std::cerr << "unsupported db config parameter id" << std::endl;
         ret_code = 1;
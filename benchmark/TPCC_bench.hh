@@ -39,7 +39,9 @@
 // @section: clp parser definitions
 enum {
     opt_dbid = 1, opt_nwhs, opt_nthrs, opt_time, opt_perf, opt_pfcnt, opt_gc,
-    opt_gr, opt_node, opt_comm, opt_verb, opt_mix
+    opt_gr, opt_node, opt_comm, opt_verb, opt_mix, opt_rcuh, opt_gcmode,
+    opt_ljson, opt_vevery, opt_vckpt, opt_mvgc,
+    opt_mvflat, opt_mvsample
 };
 
 extern const char* workload_mix_names[];
@@ -60,6 +62,8 @@ extern int tpcc_m(int, char const* const*);
 extern int tpcc_mc(int, char const* const*);
 extern int tpcc_mn(int, char const* const*);
 extern int tpcc_mcn(int, char const* const*);
+extern int tpcc_ml(int, char const* const*);
+extern int tpcc_mlc(int, char const* const*);
 
 extern int tpcc_s(int, char const* const*);
 
@@ -310,6 +314,11 @@ private:
     uint64_t w_id_end;
     uint64_t w_id_owned;
 
+    // keys and row ids for multi_select_row, kept to reuse their storage
+    std::vector<item_key> batch_item_keys;
+    std::vector<stock_key> batch_stock_keys;
+    std::vector<uintptr_t> batch_rows;
+
     friend class tpcc_access<DBParams>;
 };
 
@@ -365,6 +374,22 @@ tpcc_db<DBParams>::tpcc_db(int num_whs)
         tbl_nos_.emplace_back(999983/*num_customers * 10 * 2*/);
         tbl_hts_.emplace_back(999983/*num_customers * 2*/);
     }
+
+    if constexpr (DBParams::MVCC) {
+        tbl_its_->gc_table("item");
+        tbl_whs_.gc_table("warehouse");
+        for (auto i = 0; i < num_whs; ++i) {
+            tbl_dts_[i].gc_table("district");
+            tbl_cus_[i].gc_table("customer");
+            tbl_ods_[i].gc_table("order");
+            tbl_ols_[i].gc_table("orderline");
+            tbl_sts_[i].gc_table("stock");
+            tbl_cni_[i].gc_table("customer_idx");
+            tbl_oci_[i].gc_table("order_cidx");
+            tbl_nos_[i].gc_table("neworder");
+            tbl_hts_[i].gc_table("history");
+        }
+    }
 }
 
 template <typename DBParams>
@@ -848,7 +873,15 @@ public:
         double time_limit = 10.0;
         bool enable_gc = false;
         unsigned gc_rate = Transaction::get_epoch_cycle();
+        unsigned rcu_helpers = 0;
+        bool adaptive_gc = false;
+        bool mvcc_collector = false;
+        unsigned mvcc_flatteners = 0;
+        unsigned mvcc_chain_sample = 0;
         bool verbose = false;
+        const char* latency_json = nullptr;
+        unsigned validate_every = 0;
+        bool validate_checkpoints = false;
 
         Clp_Parser *clp = Clp_NewParser(argc, argv, noptions, options);
 
@@ -879,6 +912,38 @@ public:
                 case opt_gr:
                     gc_rate = clp->val.i;
                     break;
+                case opt_rcuh:
+                    rcu_helpers = clp->val.i;
+                    break;
+                case opt_gcmode:
+                    if (strcmp(clp->val.s, "adaptive") == 0) {
+                        adaptive_gc = true;
+                    } else if (strcmp(clp->val.s, "fixed") == 0) {
+                        adaptive_gc = false;
+                    } else {
+                        ::print_usage(argv[0]);
+                        ret = 1;
+                        clp_stop = true;
+                    }
+                    break;
+                case opt_mvgc:
+                    mvcc_collector = !clp->negated;
+                    break;
+                case opt_mvflat:
+                    mvcc_flatteners = clp->val.u;
+                    break;
+                case opt_mvsample:
+                    mvcc_chain_sample = clp->val.u;
+                    break;
+                case opt_ljson:
+                    latency_json = clp->val.s;
+                    break;
+                case opt_vevery:
+                    validate_every = clp->val.u;
+                    break;
+                case opt_vckpt:
+                    validate_checkpoints = !clp->negated;
+                    break;
                 case opt_node:
                     break;
                 case opt_comm:
@@ -919,7 +984,16 @@ public:
                       << (counter_mode ? "counter" : "record") << " mode" << std::endl;
         }
 
+        if (DBParams::MVCC && (validate_every || validate_checkpoints))
+            std::cerr << "Warning: incremental validation ignored under MVCC" << std::endl;
+        else
+            Transaction::set_incremental_validation(validate_every, validate_checkpoints);
+        Transaction::set_mvcc_read_lease(DBParams::MvReadLease);
+        MvRegistry::set_chain_sampling(mvcc_chain_sample);
+
         db_profiler prof(spawn_perf);
+        if (latency_json)
+            prof.dump_latency_json(latency_json, db_params_id_names[static_cast<int>(DBParams::Id)]);
         tpcc_db<DBParams> db(num_warehouses);
 
         std::cout << "Prepopulating database..." << std::endl;
@@ -931,11 +1005,33 @@ public:
         if (enable_gc) {
             std::cout << "enabled, running every " << gc_rate / 1000.0 << " ms";
             Transaction::set_epoch_cycle(gc_rate);
+            if (adaptive_gc) {
+                EpochController::params_type gc_params;
+                std::cout << " initially, adaptive between " << gc_params.min_us / 1000.0
+                          << " and " << gc_params.max_us / 1000.0 << " ms";
+                Transaction::set_adaptive_epoch_cycle(gc_params);
+            }
             advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+            if (rcu_helpers) {
+                std::cout << ", " << rcu_helpers << " reclamation helper(s) per NUMA node";
+                Transaction::start_rcu_helpers(topo_info, rcu_helpers);
+            }
+            if (DBParams::MVCC && mvcc_collector) {
+                std::cout << ", background MVCC collector";
+                MvRegistry::start(num_threads);
+            }
+            if (DBParams::MVCC && mvcc_flatteners) {
+                std::cout << ", " << mvcc_flatteners << " delta flattener(s)";
+                MvFlattenPool::start(num_threads + 1, mvcc_flatteners);
+            }
         } else {
             std::cout << "disabled";
         }
         std::cout << std::endl << std::flush;
+        if (mvcc_collector && !(DBParams::MVCC && enable_gc))
+            std::cerr << "Warning: --mvcc-collector needs --gc and an MVCC dbid" << std::endl;
+        if (mvcc_flatteners && !(DBParams::MVCC && enable_gc))
+            std::cerr << "Warning: --mvcc-flatteners needs --gc and an MVCC dbid" << std::endl;
 
         prof.start(profiler_mode);
         auto num_trans = run_benchmark(db, prof, num_threads, time_limit, mix, verbose);
@@ -948,6 +1044,11 @@ public:
         std::cout << "Remaining unresolved deliveries: " << remaining_deliveries << std::endl;
 
         Transaction::rcu_release_all(advancer, num_threads);
+        if (DBParams::MVCC && mvcc_flatteners) {
+            auto st = MvFlattenPool::stats();
+            std::cout << "MVCC delta flatteners: " << st.flattened << " flattened, "
+                      << st.overflows << " sent to RCU" << std::endl;
+        }
 
         return 0;
     }
@@ -60,6 +60,26 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
     char out_brand_generic[15];
     (void) out_brand_generic;
 
+    // stock keys from the home warehouse come first, so they can be looked
+    // up in one batch; line i's key is batch_stock_keys[stock_slots[i]]
+    size_t stock_slots[15];
+    batch_item_keys.clear();
+    batch_stock_keys.clear();
+    for (uint64_t i = 0; i < num_items; ++i) {
+        batch_item_keys.emplace_back(ol_i_ids[i]);
+        if (ol_supply_w_ids[i] == q_w_id) {
+            stock_slots[i] = batch_stock_keys.size();
+            batch_stock_keys.emplace_back(q_w_id, ol_i_ids[i]);
+        }
+    }
+    size_t num_local_stocks = batch_stock_keys.size();
+    for (uint64_t i = 0; i < num_items; ++i) {
+        if (ol_supply_w_ids[i] != q_w_id) {
+            stock_slots[i] = batch_stock_keys.size();
+            batch_stock_keys.emplace_back(ol_supply_w_ids[i], ol_i_ids[i]);
+        }
+    }
+
     size_t starts = 0;
 
     // begin txn
@@ -145,6 +165,17 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
 
     TXP_ACCOUNT(txp_tpcc_no_stage4, num_items);
 
+    // look up all the items and stocks first, so their misses overlap
+    uintptr_t item_rows[15];
+    uintptr_t stock_rows[15];  // indexed like batch_stock_keys
+    CHK(db.tbl_items().multi_select_row(batch_item_keys.data(), num_items, item_rows));
+    CHK(db.tbl_stocks(q_w_id).multi_select_row(batch_stock_keys.data(), num_local_stocks, stock_rows));
+    for (uint64_t i = 0; i < num_items; ++i) {
+        if (ol_supply_w_ids[i] != q_w_id)
+            CHK(db.tbl_stocks(ol_supply_w_ids[i]).multi_select_row(&batch_stock_keys[stock_slots[i]], 1,
+                                                                    &stock_rows[stock_slots[i]]));
+    }
+
     for (uint64_t i = 0; i < num_items; ++i) {
         uint64_t iid = ol_i_ids[i];
         uint64_t wid = ol_supply_w_ids[i];
@@ -153,7 +184,8 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
         uint32_t i_price;
 
         {
-        auto [abort, result, row, value] = db.tbl_items().select_split_row(item_key(iid),
+        assert(item_rows[i]);
+        auto [abort, result, row, value] = db.tbl_items().select_split_row(item_rows[i],
             {{it_nc::i_im_id, access_t::read},
              {it_nc::i_price, access_t::read},
              {it_nc::i_name, access_t::read},
@@ -169,7 +201,8 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
         }
 
         {
-        auto [abort, result, row, value] = db.tbl_stocks(wid).select_split_row(stock_key(wid, iid),
+        assert(stock_rows[stock_slots[i]]);
+        auto [abort, result, row, value] = db.tbl_stocks(wid).select_split_row(stock_rows[stock_slots[i]],
             {{st_nc::s_quantity, Commute ? access_t::write : access_t::update},
              {st_nc::s_ytd, Commute ? access_t::write : access_t::update},
              {st_nc::s_order_cnt, Commute ? access_t::write : access_t::update},
@@ -507,7 +540,7 @@ void tpcc_runner<DBParams>::run_txn_orderstatus() {
 
     size_t starts = 0;
 
-    TXN {
+    RO_TXN {
     ++starts;
 
     if (by_name) {
@@ -738,6 +771,8 @@ void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id,
             db.tbl_customers(q_w_id).update_row(row, new_cv);
         }
         }
+
+        CHK(Sto::checkpoint());
     }
 
     } TEND(true);
@@ -770,7 +805,7 @@ void tpcc_runner<DBParams>::run_txn_stocklevel(){
 
     size_t starts = 0;
 
-    TXN {
+    RO_TXN {
     ++starts;
 
     ol_iids.clear();
@@ -786,9 +821,15 @@ void tpcc_runner<DBParams>::run_txn_stocklevel(){
             );
     CHK(scan_success);
 
-    for (auto iid : ol_iids) {
-        stock_key sk(q_w_id, iid);
-        auto [success, result, row, value] = db.tbl_stocks(q_w_id).select_split_row(sk,
+    batch_stock_keys.clear();
+    for (auto iid : ol_iids)
+        batch_stock_keys.emplace_back(q_w_id, iid);
+    batch_rows.resize(batch_stock_keys.size());
+    CHK(db.tbl_stocks(q_w_id).multi_select_row(batch_stock_keys.data(), batch_stock_keys.size(), batch_rows.data()));
+
+    for (auto rid : batch_rows) {
+        assert(rid);
+        auto [success, result, row, value] = db.tbl_stocks(q_w_id).select_split_row(rid,
             {{st_nc::s_quantity, access_t::read}}
         );
         (void)row; (void)result;
@@ -0,0 +1,232 @@
+// Microbenchmark for unordered index growth: loads YCSB rows into an index
+// that starts with a few buckets and grows online, then into one presized
+// for all the rows, and compares the load times. Then times as many
+// lookups of random rows in the grown index, to compare bucket layouts,
+// and transactions of lookups made one by one or with multi_select_row.
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "compiler.hh"
+#include "clp.h"
+#include "YCSB_structs.hh"
+#include "YCSB_commutators.hh"
+#include "DB_index.hh"
+#include "DB_params.hh"
+#include "ycsb_split_params_default.hh"
+
+using namespace ycsb;
+using namespace db_params;
+
+enum { opt_nthrs = 1, opt_keys, opt_init, opt_mvcc, opt_trans, opt_slots };
+
+struct cmd_params {
+    int num_threads;
+    uint64_t num_keys;
+    uint64_t initial_buckets;
+    bool mvcc;
+    bool transactional;
+    bool slot_buckets;
+
+    cmd_params() : num_threads(1), num_keys(1 << 20), initial_buckets(1024),
+                   mvcc(false), transactional(false), slot_buckets(false) {}
+};
+
+static const Clp_Option options[] = {
+    { "nthreads",     't', opt_nthrs, Clp_ValInt,      Clp_Optional },
+    { "keys",         'k', opt_keys,  Clp_ValUnsigned, Clp_Optional },
+    { "initial",      'b', opt_init,  Clp_ValUnsigned, Clp_Optional },
+    { "mvcc",         'm', opt_mvcc,  Clp_NoVal,       Clp_Negate| Clp_Optional },
+    { "trans",        'x', opt_trans, Clp_NoVal,       Clp_Negate| Clp_Optional },
+    { "slot-buckets", 's', opt_slots, Clp_NoVal,       Clp_Negate| Clp_Optional },
+};
+
+template <typename DBParams>
+using index_type = typename std::conditional<DBParams::MVCC,
+      bench::mvcc_unordered_index<ycsb_key, ycsb_value, DBParams>,
+      bench::unordered_index<ycsb_key, ycsb_value, DBParams>>::type;
+
+template <typename DBParams>
+void loader_thread(int thread_id, index_type<DBParams>& idx, const cmd_params& p) {
+    TThread::set_id(thread_id);
+    idx.thread_init();
+    ycsb_value v;
+    for (uint64_t k = thread_id; k < p.num_keys; k += p.num_threads) {
+        if (p.transactional) {
+            RWTRANSACTION {
+                auto [success, found] = idx.insert_row(ycsb_key(k), &v);
+                TXN_DO(success);
+                (void)found;
+            } RETRY(true);
+        } else {
+            idx.nontrans_put(ycsb_key(k), v);
+        }
+    }
+}
+
+template <typename DBParams>
+void lookup_thread(int thread_id, index_type<DBParams>& idx, const cmd_params& p) {
+    typedef ycsb_value::NamedColumn nc;
+    TThread::set_id(thread_id);
+    std::mt19937_64 gen(thread_id);
+    std::uniform_int_distribution<uint64_t> dis(0, p.num_keys - 1);
+    for (uint64_t i = thread_id; i < p.num_keys; i += p.num_threads) {
+        uint64_t k = dis(gen);
+        bool found = false;
+        if constexpr (DBParams::MVCC) {
+            ROTRANSACTION {
+                auto [success, result, row, value]
+                    = idx.select_split_row(ycsb_key(k), {{nc::odd_columns, bench::access_t::read}});
+                TXN_DO(success);
+                (void)row;
+                (void)value;
+                found = result;
+            } RETRY(true);
+        } else {
+            found = idx.nontrans_get(ycsb_key(k)) != nullptr;
+        }
+        always_assert(found, "loaded row missing");
+    }
+}
+
+// Runs transactions of lookup_batch random lookups, either one key after
+// another or batched with multi_select_row
+static constexpr unsigned lookup_batch = 16;
+
+template <typename DBParams>
+void lookup_txn_thread(int thread_id, index_type<DBParams>& idx, const cmd_params& p, bool batched) {
+    typedef ycsb_value::NamedColumn nc;
+    TThread::set_id(thread_id);
+    // other keys than the previous phases, which left theirs in cache
+    std::mt19937_64 gen(p.num_threads * (batched ? 2 : 1) + thread_id);
+    std::uniform_int_distribution<uint64_t> dis(0, p.num_keys - 1);
+    std::vector<ycsb_key> keys;
+    uintptr_t rows[lookup_batch];
+    for (uint64_t i = thread_id * lookup_batch; i < p.num_keys; i += p.num_threads * lookup_batch) {
+        keys.clear();
+        for (unsigned j = 0; j != lookup_batch; ++j)
+            keys.emplace_back(dis(gen));
+        TRANSACTION {
+            if (batched) {
+                TXN_DO(idx.multi_select_row(keys.data(), lookup_batch, rows));
+                for (unsigned j = 0; j != lookup_batch; ++j) {
+                    always_assert(rows[j], "loaded row missing");
+                    auto [success, result, row, value]
+                        = idx.select_split_row(rows[j], {{nc::odd_columns, bench::access_t::read}});
+                    TXN_DO(success);
+                    (void)row;
+                    (void)value;
+                    always_assert(result, "loaded row missing");
+                }
+            } else {
+                for (unsigned j = 0; j != lookup_batch; ++j) {
+                    auto [success, result, row, value]
+                        = idx.select_split_row(keys[j], {{nc::odd_columns, bench::access_t::read}});
+                    TXN_DO(success);
+                    (void)row;
+                    (void)value;
+                    always_assert(result, "loaded row missing");
+                }
+            }
+        } RETRY(true);
+    }
+}
+
+template <typename F>
+double timed(const cmd_params& p, F thread_main) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < p.num_threads; ++i)
+        threads.emplace_back(thread_main, i);
+    for (auto& t : threads)
+        t.join();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// Returns the seconds spent loading num_keys rows into `idx`
+template <typename DBParams>
+double load(const cmd_params& p, index_type<DBParams>& idx) {
+    return timed(p, [&] (int i) { loader_thread<DBParams>(i, idx, p); });
+}
+
+template <typename DBParams>
+int run(const cmd_params& p) {
+    std::cout << "Threads: " << p.num_threads << ", rows: " << p.num_keys
+              << ", " << (p.transactional ? "transactional inserts" : "nontrans_put")
+              << ", " << (DBParams::SlotBuckets ? "slot" : "chained") << " buckets" << std::endl;
+
+    // rows are not freed with their index, so keep both for the whole run
+    auto grown_idx = new index_type<DBParams>(p.initial_buckets);
+    auto presized_idx = new index_type<DBParams>(p.num_keys);
+    double grown = load<DBParams>(p, *grown_idx);
+    double presized = load<DBParams>(p, *presized_idx);
+    double lookups = timed(p, [&] (int i) { lookup_thread<DBParams>(i, *grown_idx, p); });
+    double txn_lookups = timed(p, [&] (int i) { lookup_txn_thread<DBParams>(i, *grown_idx, p, false); });
+    double batched = timed(p, [&] (int i) { lookup_txn_thread<DBParams>(i, *grown_idx, p, true); });
+
+    printf("Growing from %-9lu %.3f s, %.3f M rows/sec, %lu buckets\n",
+           (unsigned long)p.initial_buckets, grown, p.num_keys / grown / 1e6,
+           (unsigned long)grown_idx->nbuckets());
+    printf("Presized to %-10lu %.3f s, %.3f M rows/sec, %lu buckets\n",
+           (unsigned long)p.num_keys, presized, p.num_keys / presized / 1e6,
+           (unsigned long)presized_idx->nbuckets());
+    printf("Lookups (grown)        %.3f s, %.3f M rows/sec\n",
+           lookups, p.num_keys / lookups / 1e6);
+    printf("In txns of %-2u         %.3f s, %.3f M rows/sec\n",
+           lookup_batch, txn_lookups, p.num_keys / txn_lookups / 1e6);
+    printf("Batched in txns of %-2u %.3f s, %.3f M rows/sec\n",
+           lookup_batch, batched, p.num_keys / batched / 1e6);
+
+    std::thread advancer;
+    Transaction::rcu_release_all(advancer, p.num_threads);
+    return 0;
+}
+
+int main(int argc, const char * const *argv) {
+    cmd_params p;
+
+    Sto::global_init();
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    int ret_code = 0;
+    int opt;
+    bool clp_stop = false;
+    while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
+        switch (opt) {
+        case opt_nthrs:
+            p.num_threads = clp->val.i;
+            break;
+        case opt_keys:
+            p.num_keys = clp->val.u;
+            break;
+        case opt_init:
+            p.initial_buckets = clp->val.u;
+            break;
+        case opt_mvcc:
+            p.mvcc = !clp->negated;
+            break;
+        case opt_trans:
+            p.transactional = !clp->negated;
+            break;
+        case opt_slots:
+            p.slot_buckets = !clp->negated;
+            break;
+        default:
+            ret_code = 1;
+            clp_stop = true;
+            break;
+        }
+    }
+    Clp_DeleteParser(clp);
+    if (ret_code != 0)
+        return ret_code;
+
+    if (p.mvcc)
+        return run<db_mvcc_params>(p);
+    if (p.slot_buckets)
+        return run<db_default_slot_params>(p);
+    return run<db_default_params>(p);
+}
@@ -27,7 +27,8 @@ int* wikipedia::wikipedia_loader<DBParams>::page_last_rev_lens = nullptr;
 
 // @section: clp parser definitions
 enum {
-    opt_dbid = 1, opt_nthrs, opt_users, opt_pages, opt_time, opt_gc, opt_comm, opt_perf, opt_pfcnt
+    opt_dbid = 1, opt_nthrs, opt_users, opt_pages, opt_time, opt_gc, opt_comm, opt_perf, opt_pfcnt,
+    opt_vevery, opt_vckpt, opt_mvsample, opt_ljson, opt_lthrs
 };
 
 static const Clp_Option options[] = {
@@ -39,7 +40,12 @@ static const Clp_Option options[] = {
         { "garbage-collect", 'b', opt_gc, Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "perf",         'p', opt_perf,  Clp_NoVal,     Clp_Optional },
-        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional }
+        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "validate-every", 0, opt_vevery, Clp_ValUnsigned, Clp_Optional },
+        { "validate-checkpoints", 0, opt_vckpt, Clp_NoVal, Clp_Negate | Clp_Optional },
+        { "mvcc-chain-sample", 0, opt_mvsample, Clp_ValUnsigned, Clp_Optional },
+        { "latency-json", 0,   opt_ljson, Clp_ValString, Clp_Optional },
+        { "load-threads", 0,   opt_lthrs, Clp_ValInt,    Clp_Optional }
 };
 
 static inline void print_usage(const char *argv_0) {
@@ -63,7 +69,20 @@ static inline void print_usage(const char *argv_0) {
        << "  --perf (or -p)" << std::endl
        << "    Spawns perf profiler in record mode for the duration of the benchmark run." << std::endl
        << "  --perf-counter (or -c)" << std::endl
-       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl;
+       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl
+       << "  --validate-every=<NUM>" << std::endl
+       << "    Revalidate the OCC read set after every NUM new reads and abort early if stale (default 0, off)." << std::endl
+       << "  --validate-checkpoints" << std::endl
+       << "    Also revalidate at the checkpoints in long transactions (default off)." << std::endl
+       << "  --mvcc-chain-sample=<NUM>" << std::endl
+       << "    With an MVCC dbid, sample version chain and delta run lengths per table at every NUM-th" << std::endl
+       << "    installed version on each thread (default 0, off)." << std::endl
+       << "  --latency-json=<FILE>" << std::endl
+       << "    Write latency histograms (needs a TSC_PROFILE=1 build) and MVCC per-table history" << std::endl
+       << "    statistics to FILE as JSON." << std::endl
+       << "  --load-threads=<NUM>" << std::endl
+       << "    Bulk-load the tables in sorted batches with NUM threads, or with 0, insert each row as it is" << std::endl
+       << "    generated; each table's load time is printed (default: the number of worker threads)." << std::endl;
     std::cout << ss.str() << std::flush;
 }
 
@@ -77,12 +96,19 @@ struct cmd_params {
     bool enable_comm;
     bool spawn_perf;
     bool perf_counter_mode;
+    unsigned validate_every;
+    bool validate_checkpoints;
+    unsigned mvcc_chain_sample;
+    const char* latency_json;
+    int num_load_threads;  // -1: num_threads
 
     explicit cmd_params()
         : db_id(db_params::db_params_id::Default),
           num_threads(1), scale_user(10), scale_page(10),
           time(10.0), enable_gc(false), enable_comm(false),
-          spawn_perf(false), perf_counter_mode(false) {}
+          spawn_perf(false), perf_counter_mode(false),
+          validate_every(0), validate_checkpoints(false),
+          mvcc_chain_sample(0), latency_json(nullptr), num_load_threads(-1) {}
 };
 
 // @endsection: clp parser definitions
@@ -103,7 +129,8 @@ public:
     static int execute(cmd_params p) {
         size_t num_users = wikipedia::constants::users * (size_t)p.scale_user;
         size_t num_pages = wikipedia::constants::pages * (size_t)p.scale_page;
-        wikipedia::load_params lp = {num_users, num_pages};
+        int num_load_threads = p.num_load_threads < 0 ? p.num_threads : p.num_load_threads;
+        wikipedia::load_params lp = {num_users, num_pages, num_load_threads};
         wikipedia::run_params rp(num_users, num_pages, p.time, wikipedia::workload_weightgram);
 
         // Create DB
@@ -131,6 +158,8 @@ public:
         }
 
         profiler_type profiler(p.spawn_perf);
+        if (p.latency_json)
+            profiler.dump_latency_json(p.latency_json, db_params_id_names[static_cast<int>(DBParams::Id)]);
         profiler.start(p.perf_counter_mode ? Profiler::perf_mode::counters : Profiler::perf_mode::record);
 
         for (int t = 0; t < p.num_threads; ++t) {
@@ -230,6 +259,21 @@ int main(int argc, const char * const *argv) {
         case opt_pfcnt:
             params.perf_counter_mode = !clp->negated;
             break;
+        case opt_vevery:
+            params.validate_every = clp->val.u;
+            break;
+        case opt_vckpt:
+            params.validate_checkpoints = !clp->negated;
+            break;
+        case opt_mvsample:
+            params.mvcc_chain_sample = clp->val.u;
+            break;
+        case opt_ljson:
+            params.latency_json = clp->val.s;
+            break;
+        case opt_lthrs:
+            params.num_load_threads = clp->val.i;
+            break;
         default:
             print_usage(argv[0]);
             ret_code = 1;
@@ -242,6 +286,12 @@ int main(int argc, const char * const *argv) {
     if (ret_code != 0)
         return ret_code;
 
+    if (params.db_id == db_params_id::MVCC && (params.validate_every || params.validate_checkpoints))
+        std::cerr << "Warning: incremental validation ignored under MVCC" << std::endl;
+    else
+        Transaction::set_incremental_validation(params.validate_every, params.validate_checkpoints);
+    MvRegistry::set_chain_sampling(params.mvcc_chain_sample);
+
     auto cpu_freq = determine_cpu_freq();
     if (cpu_freq == 0.0)
         return 1;
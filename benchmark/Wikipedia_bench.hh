@@ -83,7 +83,20 @@ public:
         idx_user_(),
         //tbl_ug_(),
         tbl_wl_(),
-        idx_wl_() {}
+        idx_wl_() {
+        if constexpr (DBParams::MVCC) {
+            tbl_log_.gc_table("logging");
+            tbl_page_.gc_table("page");
+            idx_page_.gc_table("page_idx");
+            tbl_rc_.gc_table("recentchanges");
+            tbl_rev_.gc_table("revision");
+            tbl_text_.gc_table("text");
+            tbl_user_.gc_table("useracct");
+            idx_user_.gc_table("useracct_idx");
+            tbl_wl_.gc_table("watchlist");
+            idx_wl_.gc_table("watchlist_idx");
+        }
+    }
 
     /*
     ipb_tbl_type& tbl_ipblocks() {
@@ -203,6 +216,7 @@ struct run_params {
 struct load_params {
     uint64_t num_users;
     uint64_t num_pages;
+    int num_load_threads;  // 0 loads each row with nontrans_put as it is generated
 };
 
 // Pre-processed input distribution from wikibench trace (from OLTPBench)
@@ -531,7 +545,8 @@ public:
 
     explicit wikipedia_loader(wikipedia_db<DBParams>& wdb, const load_params& params)
             : num_users((int)params.num_users), num_pages((int)params.num_pages),
-              db(wdb), ig(6332, params.num_users, params.num_pages) {}
+              num_load_threads(params.num_load_threads), db(wdb),
+              ig(6332, params.num_users, params.num_pages) {}
 
     void load();
 
@@ -560,13 +575,16 @@ public:
     }
 
 private:
-    void load_useracct();
-    void load_page();
-    void load_watchlist();
-    void load_revision();
+    void load_useracct(bench::ordered_bulk_loader& loader);
+    void load_page(bench::ordered_bulk_loader& loader);
+    void load_watchlist(bench::ordered_bulk_loader& loader);
+    void load_revision(bench::ordered_bulk_loader& loader);
+    template <typename Stream>
+    void finish_table(const char* name, Stream& stream);
 
     int num_users;
     int num_pages;
+    int num_load_threads;
     wikipedia_db<DBParams>& db;
     loadtime_input_generator ig;
 };
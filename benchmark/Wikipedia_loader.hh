@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <set>
 #include "Wikipedia_bench.hh"
 
@@ -9,18 +10,33 @@ template <typename DBParams>
 void wikipedia_loader<DBParams>::load() {
     std::cout << "Loading database..." << std::endl;
 
-    wikipedia_loader::initialize_scratch_space((size_t)num_users, (size_t)num_pages);
-    load_revision();
-    load_useracct();
-    load_page();
-    load_watchlist();
-    wikipedia_loader::free_scratch_space();
+    auto start = std::chrono::steady_clock::now();
+    {
+        bench::ordered_bulk_loader loader(num_load_threads);
+        wikipedia_loader::initialize_scratch_space((size_t)num_users, (size_t)num_pages);
+        load_revision(loader);
+        load_useracct(loader);
+        load_page(loader);
+        load_watchlist(loader);
+        wikipedia_loader::free_scratch_space();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-    std::cout << "Loaded." << std::endl;
+    std::cout << "Loaded in " << elapsed.count() << " s with " << num_load_threads << " load threads." << std::endl;
 }
 
+// Finishes loading a table and prints its row count and load time
 template <typename DBParams>
-void wikipedia_loader<DBParams>::load_useracct() {
+template <typename Stream>
+void wikipedia_loader<DBParams>::finish_table(const char* name, Stream& stream) {
+    stream.finish();
+    double rate = stream.seconds() > 0 ? stream.rows() / stream.seconds() : 0;
+    printf("  %-14s %10zu rows in %8.3f s (%.0f rows/s)\n", name, stream.rows(), stream.seconds(), rate);
+}
+
+template <typename DBParams>
+void wikipedia_loader<DBParams>::load_useracct(bench::ordered_bulk_loader& loader) {
+    auto users = db.tbl_useracct().bulk_load(loader);
     for (int uid = 1; uid <= num_users; ++uid) {
         useracct_row u_r;
         u_r.user_name = ig.generate_user_name();
@@ -38,12 +54,15 @@ void wikipedia_loader<DBParams>::load_useracct() {
         u_r.user_registration = "null";
         u_r.user_editcount = user_revision_cnts[uid - 1];
 
-        db.tbl_useracct().nontrans_put(useracct_key(uid), u_r);
+        users.add(useracct_key(uid), u_r);
     }
+    finish_table("useracct", users);
 }
 
 template <typename DBParams>
-void wikipedia_loader<DBParams>::load_page() {
+void wikipedia_loader<DBParams>::load_page(bench::ordered_bulk_loader& loader) {
+    auto pages = db.tbl_page().bulk_load(loader);
+    auto page_idx = db.idx_page().bulk_load(loader);
     for (int pid = 1; pid <= num_pages; ++pid) {
         int page_ns = ig.generate_page_namespace(pid);
         auto page_title = ig.generate_page_title(pid);
@@ -60,16 +79,20 @@ void wikipedia_loader<DBParams>::load_page() {
         pg_r.page_latest = page_last_rev_ids[pid - 1];
         pg_r.page_len = page_last_rev_lens[pid - 1];
 
-        db.tbl_page().nontrans_put(page_key(pid), pg_r);
+        pages.add(page_key(pid), pg_r);
 
         page_idx_row pi_r{};
         pi_r.page_id = pid;
-        db.idx_page().nontrans_put(page_idx_key(page_ns, page_title), pi_r);
+        page_idx.add(page_idx_key(page_ns, page_title), pi_r);
     }
+    finish_table("page", pages);
+    finish_table("page_idx", page_idx);
 }
 
 template <typename DBParams>
-void wikipedia_loader<DBParams>::load_watchlist() {
+void wikipedia_loader<DBParams>::load_watchlist(bench::ordered_bulk_loader& loader) {
+    auto watchlist = db.tbl_watchlist().bulk_load(loader);
+    auto watchlist_idx = db.idx_watchlist().bulk_load(loader);
     std::set<int> user_pages;
     for (int uid = 1; uid <= num_users; ++uid) {
         user_pages.clear();
@@ -96,15 +119,18 @@ void wikipedia_loader<DBParams>::load_watchlist() {
             watchlist_row wl_r;
             wl_r.wl_notificationtimestamp = "null";
 
-            db.tbl_watchlist().nontrans_put(wl_k, wl_r);
-            db.idx_watchlist().nontrans_put(wl_i_k, watchlist_idx_row());
+            watchlist.add(wl_k, wl_r);
+            watchlist_idx.add(wl_i_k, watchlist_idx_row());
         }
     }
+    finish_table("watchlist", watchlist);
+    finish_table("watchlist_idx", watchlist_idx);
 }
 
 template <typename DBParams>
-void wikipedia_loader<DBParams>::load_revision() {
-
+void wikipedia_loader<DBParams>::load_revision(bench::ordered_bulk_loader& loader) {
+    auto texts = db.tbl_text().bulk_load(loader);
+    auto revisions = db.tbl_revision().bulk_load(loader);
     for (int pid = 1; pid <= num_pages; ++pid) {
         auto num_revs = ig.generate_num_revisions();
         auto old_text = ig.generate_random_old_text();
@@ -128,7 +154,7 @@ void wikipedia_loader<DBParams>::load_revision() {
             memcpy(t_r.old_text, old_text.c_str(), old_text_len + 1);
             t_r.old_flags = "utf-8";
             t_r.old_page = pid;
-            db.tbl_text().nontrans_put(t_k, t_r);
+            texts.add(t_k, t_r);
 
             revision_key r_k(tr_id);
             revision_row r_r;
@@ -143,12 +169,14 @@ void wikipedia_loader<DBParams>::load_revision() {
             r_r.rev_len = (int)old_text_len;
             r_r.rev_parent_id = 0;
 
-            db.tbl_revision().nontrans_put(r_k, r_r);
+            revisions.add(r_k, r_r);
 
             page_last_rev_ids[pid - 1] = tr_id;
             page_last_rev_lens[pid - 1] = tr_id;
         }
     }
+    finish_table("text", texts);
+    finish_table("revision", revisions);
 }
 
 }; // namespace wikipedia
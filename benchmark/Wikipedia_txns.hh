@@ -129,7 +129,7 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAnony
     size_t nexecs = 0;
     article_type art;
 
-    TRANSACTION {
+    ROTRANSACTION {
 
     ++nexecs;
 
@@ -238,7 +238,7 @@ std::pair<size_t, article_type> wikipedia_runner<DBParams>::run_txn_getPageAuthe
     size_t nexecs = 0;
     article_type art;
 
-    TRANSACTION {
+    ROTRANSACTION {
 
     ++nexecs;
 
@@ -475,6 +475,8 @@ bool wikipedia_runner<DBParams>::txn_updatePage_inner(int text_id,
     }
     }
 
+    TXN_CHECK(Sto::checkpoint());
+
     // INSERT RECENT CHANGES
     recentchanges_key rc_k((int32_t)(db.tbl_recentchanges().gen_key()));
 
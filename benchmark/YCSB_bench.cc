@@ -14,7 +14,7 @@ using bench::db_profiler;
 
 enum {
     opt_dbid = 1, opt_nthrs, opt_mode, opt_time, opt_perf, opt_pfcnt, opt_gc,
-    opt_node, opt_comm
+    opt_node, opt_comm, opt_rcuh, opt_gcmode, opt_tids, opt_ljson, opt_slots
 };
 
 static const Clp_Option options[] = {
@@ -27,6 +27,11 @@ static const Clp_Option options[] = {
     { "gc",           'g', opt_gc,    Clp_NoVal,     Clp_Negate| Clp_Optional },
     { "node",         'n', opt_node,  Clp_NoVal,     Clp_Negate| Clp_Optional },
     { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate| Clp_Optional },
+    { "rcu-helpers",  0,   opt_rcuh,  Clp_ValInt,    Clp_Optional },
+    { "gc-mode",      0,   opt_gcmode, Clp_ValString, Clp_Optional },
+    { "tid-sweep",    0,   opt_tids,  Clp_NoVal,     Clp_Negate| Clp_Optional },
+    { "latency-json", 0,   opt_ljson, Clp_ValString, Clp_Optional },
+    { "slot-buckets", 0,   opt_slots, Clp_NoVal,     Clp_Negate| Clp_Optional },
 };
 
 static inline void print_usage(const char *argv_0) {
@@ -34,11 +39,14 @@ static inline void print_usage(const char *argv_0) {
     ss << "Usage of " << std::string(argv_0) << ":" << std::endl
        << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
        << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
-       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode" << std::endl
+       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode," << std::endl
+       << "      mvcclease (MVCC whose reads lease versions instead of writing their rtids)" << std::endl
        << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
        << "    Specify the number of threads (or TPCC workers/terminals, default 1)." << std::endl
        << "  --mode=<CHAR> (or -m<CHAR>)" << std::endl
-       << "    Specify which YCSB variant to run (A/B/C, default C)." << std::endl
+       << "    Specify which YCSB variant to run (A/B/C, default C). L runs updates on a 1024-key" << std::endl
+       << "    hot set with one long read-only transaction over all of it on thread 0 (needs 2+ threads;" << std::endl
+       << "    build with FIND_SKIP=<levels> to index long MVCC version chains)." << std::endl
        << "  --time=<NUM> (or -l<NUM>)" << std::endl
        << "    Specify the time (duration) for which the benchmark is run (default 10 seconds)." << std::endl
        << "  --perf (or -p)" << std::endl
@@ -47,10 +55,24 @@ static inline void print_usage(const char *argv_0) {
        << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl
        << "  --gc (or -g)" << std::endl
        << "    Enable garbage collection (default false)." << std::endl
+       << "  --rcu-helpers=<NUM>" << std::endl
+       << "    With --gc, run RCU callbacks on NUM helper threads per NUMA node instead of the workers (default 0)." << std::endl
+       << "  --gc-mode=<fixed|adaptive>" << std::endl
+       << "    With adaptive, tune the GC epoch length at runtime from RCU backlog, MVCC chain length" << std::endl
+       << "    and commit rate, starting from 1 ms (default fixed)." << std::endl
+       << "  --latency-json=<FILE>" << std::endl
+       << "    Write per-thread and combined latency histograms (execution, commit phases, end-to-end)" << std::endl
+       << "    to FILE as JSON. Needs a TSC_PROFILE=1 build." << std::endl
+       << "  --tid-sweep" << std::endl
+       << "    Run with 1, 2, 4, ... up to --nthreads threads and report throughput and commit TID" << std::endl
+       << "    allocation cost at each point (cost needs a TSC_PROFILE=1 build; compare TID_LEASE builds)." << std::endl
        << "  --node (or -n)" << std::endl
        << "    Enable node tracking (default false)." << std::endl
        << "  --commute (or -x)" << std::endl
-       << "    Enable commutative updates in MVCC (default false)." << std::endl;
+       << "    Enable commutative updates in MVCC (default false)." << std::endl
+       << "  --slot-buckets" << std::endl
+       << "    With --dbid=default, keep hash index rows in tagged cache-line bucket slots instead of" << std::endl
+       << "    bucket chains (default false)." << std::endl;
     std::cout << ss.str() << std::flush;
 }
 
@@ -146,6 +168,8 @@ public:
             tsize = -2;
         } else if (mode == mode_id::ReadCollapse) {
             tsize = -3;
+        } else if (mode == mode_id::LongReader) {
+            tsize = -4;
         }
         for (uint64_t i = 0; i < runners.size(); ++i) {
             thrs.emplace_back(
@@ -180,6 +204,35 @@ public:
     }
 
 
+    // Scalability sweep of commit TID allocation (see STO_TID_LEASE)
+    static void run_tid_sweep(ycsb_db<DBParams>& db, mode_id mode, int max_threads, double time_limit) {
+        std::cout << "TID allocation sweep (lease size " << STO_TID_LEASE << "):" << std::endl
+                  << "threads, txns/sec, tid alloc cycles/txn" << std::endl;
+        for (int n = 1; ; n = std::min(2 * n, max_threads)) {
+            std::vector<ycsb_runner<DBParams>> runners;
+            for (int i = 0; i < n; ++i) {
+                runners.emplace_back(i, db, mode);
+            }
+            workload_generation(runners, mode);
+            Transaction::clear_stats();
+
+            db_profiler prof(false);
+            prof.start(Profiler::perf_mode::record);
+            auto result = run_benchmark(db, prof, runners, time_limit);
+            double secs = db_profiler::ticks_to_secs(read_tsc() - prof.start_timestamp());
+
+            auto tcs = Transaction::tc_counters_combined();
+            std::cout << n << ", " << result.count / secs << ", ";
+            if (STO_TSC_PROFILE && result.count)
+                std::cout << (double) tcs.timing_counter(tc_tid_alloc) / result.count;
+            else
+                std::cout << "n/a";
+            std::cout << std::endl;
+            if (n >= max_threads)
+                break;
+        }
+    }
+
     static int execute(int argc, const char *const *argv) {
         int ret = 0;
 
@@ -189,6 +242,10 @@ public:
         mode_id mode = mode_id::ReadOnly;
         double time_limit = 10.0;
         bool enable_gc = false;
+        unsigned rcu_helpers = 0;
+        bool adaptive_gc = false;
+        bool tid_sweep = false;
+        const char* latency_json = nullptr;
 
         Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
 
@@ -221,6 +278,9 @@ public:
                 case 'Z':
                     mode = mode_id::ReadCollapse;
                     break;
+                case 'L':
+                    mode = mode_id::LongReader;
+                    break;
                 default:
                     print_usage(argv[0]);
                     ret = 1;
@@ -241,10 +301,32 @@ public:
             case opt_gc:
                 enable_gc = !clp->negated;
                 break;
+            case opt_rcuh:
+                rcu_helpers = clp->val.i;
+                break;
+            case opt_tids:
+                tid_sweep = !clp->negated;
+                break;
+            case opt_ljson:
+                latency_json = clp->val.s;
+                break;
+            case opt_gcmode:
+                if (strcmp(clp->val.s, "adaptive") == 0) {
+                    adaptive_gc = true;
+                } else if (strcmp(clp->val.s, "fixed") == 0) {
+                    adaptive_gc = false;
+                } else {
+                    print_usage(argv[0]);
+                    ret = 1;
+                    clp_stop = true;
+                }
+                break;
             case opt_node:
                 break;
             case opt_comm:
                 break;
+            case opt_slots:
+                break;
             default:
                 print_usage(argv[0]);
                 ret = 1;
@@ -270,7 +352,11 @@ public:
                       << (counter_mode ? "counter" : "record") << " mode" << std::endl;
         }
 
+        Transaction::set_mvcc_read_lease(DBParams::MvReadLease);
+
         db_profiler prof(spawn_perf);
+        if (latency_json)
+            prof.dump_latency_json(latency_json, db_params_id_names[static_cast<int>(DBParams::Id)]);
         ycsb_db<DBParams> db;
 
         std::cout << "Prepopulating database..." << std::endl;
@@ -278,28 +364,49 @@ public:
         std::cout << "Prepopulation complete." << std::endl;
 
         std::vector<ycsb_runner<DBParams>> runners;
-        for (int i = 0; i < num_threads; ++i) {
-            runners.emplace_back(i, db, mode);
+        if (!tid_sweep) {
+            for (int i = 0; i < num_threads; ++i) {
+                runners.emplace_back(i, db, mode);
+            }
+            std::cout << "Generating workload..." << std::endl;
+            workload_generation(runners, mode);
+            std::cout << "Done." << std::endl;
         }
 
         std::thread advancer;
-        std::cout << "Generating workload..." << std::endl;
-        workload_generation(runners, mode);
-        std::cout << "Done." << std::endl;
         std::cout << "Garbage collection: ";
         if (enable_gc) {
             std::cout << "enabled, running every 1 ms";
             Transaction::set_epoch_cycle(1000);
+            if (adaptive_gc) {
+                EpochController::params_type gc_params;
+                std::cout << " initially, adaptive between " << gc_params.min_us / 1000.0
+                          << " and " << gc_params.max_us / 1000.0 << " ms";
+                Transaction::set_adaptive_epoch_cycle(gc_params);
+            }
             advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+            if (rcu_helpers) {
+                std::cout << ", " << rcu_helpers << " reclamation helper(s) per NUMA node";
+                Transaction::start_rcu_helpers(topo_info, rcu_helpers);
+            }
         } else {
             std::cout << "disabled";
         }
         std::cout << std::endl << std::flush;
 
+        if (tid_sweep) {
+            run_tid_sweep(db, mode, num_threads, time_limit);
+            Transaction::rcu_release_all(advancer, num_threads);
+            return 0;
+        }
+
         prof.start(profiler_mode);
         auto result = run_benchmark(db, prof, runners, time_limit);
         auto elapsed_ms = prof.finish(result.count);
-        if (result.collapse1_count || result.collapse2_count) {
+        if (mode == mode_id::LongReader) {
+            std::cout << "OLTP throughput: " << (double)result.collapse1_count / (elapsed_ms / 1000) << " txns/sec" << std::endl;
+            std::cout << "Long reader throughput: " << (double)result.collapse2_count / (elapsed_ms / 1000) << " txns/sec" << std::endl;
+        } else if (result.collapse1_count || result.collapse2_count) {
             std::cout << "Collapse 1 throughput: " << (double)result.collapse1_count / (elapsed_ms / 1000) << " txns/sec" << std::endl;
             std::cout << "Collapse 2 throughput: " << (double)result.collapse2_count / (elapsed_ms / 1000) << " txns/sec" << std::endl;
         }
@@ -329,6 +436,7 @@ int main(int argc, const char *const *argv) {
     bool clp_stop = false;
     bool node_tracking = false;
     bool enable_commute = false;
+    bool slot_buckets = false;
     while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
         switch (opt) {
         case opt_dbid:
@@ -347,6 +455,9 @@ int main(int argc, const char *const *argv) {
         case opt_comm:
             enable_commute = !clp->negated;
             break;
+        case opt_slots:
+            slot_buckets = !clp->negated;
+            break;
         default:
             break;
         }
@@ -364,7 +475,16 @@ int main(int argc, const char *const *argv) {
 
     switch (dbid) {
     case db_params_id::Default:
-        if (node_tracking && enable_commute) {
+        if (slot_buckets) {
+            if (node_tracking) {
+                std::cerr << "Warning: node tracking option ignored." << std::endl;
+            }
+            if (enable_commute) {
+                ret_code = ycsb_access<db_default_commute_slot_params>::execute(argc, argv);
+            } else {
+                ret_code = ycsb_access<db_default_slot_params>::execute(argc, argv);
+            }
+        } else if (node_tracking && enable_commute) {
             ret_code = ycsb_access<db_default_commute_node_params>::execute(argc, argv);
         } else if (node_tracking) {
             ret_code = ycsb_access<db_default_node_params>::execute(argc, argv);
@@ -409,6 +529,16 @@ int main(int argc, const char *const *argv) {
             ret_code = ycsb_access<db_mvcc_params>::execute(argc, argv);
         }
         break;
+    case db_params_id::MVCCLease:
+        if (node_tracking) {
+            std::cerr << "Warning: node tracking option ignored." << std::endl;
+        }
+        if (enable_commute) {
+            ret_code = ycsb_access<db_mvcc_lease_commute_params>::execute(argc, argv);
+        } else {
+            ret_code = ycsb_access<db_mvcc_lease_params>::execute(argc, argv);
+        }
+        break;
     default:
         std::cerr << "unknown db config parameter id" << std::endl;
         ret_code = 1;
@@ -29,6 +29,9 @@ using bench::mvcc_unordered_index;
 using bench::unordered_index;
 
 static constexpr uint64_t ycsb_table_size = 10000000;
+// The table starts smaller and grows to about one bucket per row while it
+// is prepopulated.
+static constexpr uint64_t ycsb_initial_buckets = 1 << 20;
 
 template <typename DBParams>
 class ycsb_db {
@@ -44,7 +47,7 @@ public:
 
     typedef UIndex<ycsb_key, ycsb_value> ycsb_table_type;
 
-    explicit ycsb_db() : ycsb_table_(ycsb_table_size) {}
+    explicit ycsb_db() : ycsb_table_(ycsb_initial_buckets) {}
 
     ycsb_table_type& ycsb_table() {
         return ycsb_table_;
@@ -104,6 +107,7 @@ public:
             case mode_id::WriteCollapse:
             case mode_id::RWCollapse:
             case mode_id::ReadCollapse:
+            case mode_id::LongReader:
                 dd = new sampling::StoZipfDistribution<>(ig.generator(), 0, ycsb_table_size - 1, 0.8);
                 write_threshold = (uint32_t) (std::numeric_limits<uint32_t>::max()/20);
                 break;
@@ -132,6 +136,10 @@ private:
     sampling::StoRandomDistribution<> *dd;
 
     uint32_t write_threshold;
+
+    // keys and row ids for multi_select_row, kept to reuse their storage
+    std::vector<ycsb_key> batch_keys;
+    std::vector<uintptr_t> batch_rows;
 };
 
 }; // namespace ycsb
@@ -16,7 +16,7 @@ using bench::version_adapter;
 
 enum class mode_id : int {
     ReadOnly = 0, MediumContention, HighContention,
-    WriteCollapse, RWCollapse, ReadCollapse
+    WriteCollapse, RWCollapse, ReadCollapse, LongReader
 };
 
 struct ycsb_key {
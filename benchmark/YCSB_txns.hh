@@ -7,6 +7,7 @@
 namespace ycsb {
 
 static constexpr uint64_t max_txns = 200000;
+static constexpr int long_reader_keys = 1024;  // hot set of mode_id::LongReader
 
 template <typename DBParams>
 void ycsb_runner<DBParams>::gen_workload(uint64_t threadid, int txn_size) {
@@ -35,6 +36,14 @@ void ycsb_runner<DBParams>::gen_workload(uint64_t threadid, int txn_size) {
                 txn_size = 16;
                 tsz_factor = collapse_type == 2 ? 64 : 1;
                 write_first = true;
+            } else if (collapse == 4) {
+                // Thread 0 reads the whole hot set in one long transaction
+                // while the others update it, so its snapshot falls further
+                // behind the version chains as it runs.
+                collapse_type = threadid ? 1 : 2;
+                txn_size = collapse_type == 2 ? long_reader_keys : 16;
+                tsz_factor = collapse_type == 2 ? 1 : long_reader_keys / 16;
+                write_first = false;
             }
         }
         txn.ops.reserve(txn_size);
@@ -56,7 +65,10 @@ void ycsb_runner<DBParams>::gen_workload(uint64_t threadid, int txn_size) {
         bool any_write = false;
         for (auto it = key_set.begin(); it != key_set.end(); ++it) {
             ycsb_op_t op {};
-            if (collapse) {
+            if (collapse == 4) {
+                op.is_write = collapse_type == 1 && ud->sample() < write_threshold * 10;
+                txn.collapse_type = collapse_type;
+            } else if (collapse) {
                 op.is_write = (collapse_type == 2) || (write_first && it == key_set.begin());
                 txn.collapse_type = collapse_type;
             } else {
@@ -84,18 +96,26 @@ void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
 
     (void)output;
 
+    batch_keys.clear();
+    for (auto& op : txn.ops)
+        batch_keys.emplace_back(op.key);
+    batch_rows.resize(batch_keys.size());
+
     TRANSACTION {
         if (DBParams::MVCC && txn.rw_txn) {
             Sto::mvcc_rw_upgrade();
         }
-        for (auto& op : txn.ops) {
+        // look up all the rows first, so their misses overlap
+        TXN_DO(db.ycsb_table().multi_select_row(batch_keys.data(), batch_keys.size(), batch_rows.data()));
+        for (size_t i = 0; i != txn.ops.size(); ++i) {
+            auto& op = txn.ops[i];
             bool col_parity = op.col_n % 2;
             auto col_group = col_parity ? nm::odd_columns : nm::even_columns;
             (void)col_group;
+            assert(batch_rows[i]);
             if (op.is_write) {
-                ycsb_key key(op.key);
                 auto [success, result, row, value]
-                    = db.ycsb_table().select_split_row(key,
+                    = db.ycsb_table().select_split_row(batch_rows[i],
                     {{col_group, Commute ? access_t::write : access_t::update}}
                 );
                 (void)result;
@@ -132,9 +152,8 @@ void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
                     db.ycsb_table().update_row(row, new_val);
                 }
             } else {
-                ycsb_key key(op.key);
                 auto [success, result, row, value]
-                    = db.ycsb_table().select_split_row(key, {{col_group, access_t::read}});
+                    = db.ycsb_table().select_split_row(batch_rows[i], {{col_group, access_t::read}});
                 (void)result; (void)row;
                 TXN_DO(success);
                 assert(result);
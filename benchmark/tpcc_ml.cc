@@ -0,0 +1,8 @@
+#include "TPCC_bench.hh"
+#include "TPCC_txns.hh"
+
+using namespace tpcc;
+
+int tpcc_ml(int argc, char const* const* argv) {
+    return tpcc_access<db_mvcc_lease_params>::execute(argc, argv);
+}
@@ -646,7 +646,7 @@ public:
                 auto hprev = item.read_value<history_type*>();
                 // Lock fails if prev history element has already been read
                 // in the future
-                if (Sto::commit_tid() < hprev->rtid()) {
+                if (e->obj.read_past(Sto::commit_tid(), hprev)) {
                     TransProxy(txn, item).add_write(nullptr);
                     return false;
                 }
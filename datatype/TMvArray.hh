@@ -48,7 +48,7 @@ public:
         else {
             history_type *h = data_[i].v.find(Sto::read_tid());
             MvAccess::template read<T>(item, h);
-            ret = h->v();
+            ret = h->value();
             return true;
         }
     }
@@ -64,9 +64,55 @@ public:
                 throw Transaction::Abort();
             }
             MvAccess::template read<T>(item, h);
-            return h->v();
+            return h->value();
         }
     }
+    // Reads elements [first, last) into out at the transaction's read TID.
+    // The whole slice is recorded, and validated, as one TransItem rather
+    // than one per element; read-only snapshot transactions record nothing.
+    // Elements this transaction has written read back as written.
+    bool transGet_slice(size_type first, size_type last, value_type* out) const {
+        assert(first <= last && last <= N);
+        auto rtid = Sto::read_tid();
+        if (Sto::mvcc_ro()) {
+            for (size_type i = first; i != last; ++i) {
+                prefetch_slice(i, last);
+                out[i - first] = data_[i].v.find(rtid)->value();
+            }
+            return true;
+        }
+
+        auto item = Sto::item(this, slice_key(first, last));
+        bool reread = item.has_read();
+        slice_type hs;
+        if (reread) {
+            hs = item.template read_value<slice_type>();
+        } else {
+            hs.resize(last - first);
+        }
+        for (size_type i = first; i != last; ++i) {
+            prefetch_slice(i, last);
+            auto& h = hs[i - first];
+            if (!reread) {
+                h = data_[i].v.find(rtid);
+            }
+            out[i - first] = h->value();
+            auto witem = Sto::check_item(this, i);
+            if (witem && witem->has_write()) {
+                if (witem->has_commute()) {
+                    witem->template write_value<comm_type>().operate(out[i - first]);
+                } else {
+                    out[i - first] = witem->template write_value<T>();
+                }
+            }
+        }
+        if (!reread) {
+            item.add_flags(slice_bit);
+            MvAccess::template read_all<T>(item, std::move(hs));
+        }
+        return true;
+    }
+
     bool transPut(size_type i, T x) const {
         assert(i < N);
         Sto::item(this, i).add_write(x);
@@ -102,7 +148,7 @@ public:
         } else {
             hprev = v.find(Sto::read_tid(), false);
         }
-        if (Sto::commit_tid() < hprev->rtid()) {
+        if (v.read_past(Sto::commit_tid(), hprev)) {
             TransProxy(txn, item).add_write(nullptr);
             return false;
         }
@@ -127,6 +173,16 @@ public:
     bool check(TransItem& item, Transaction&) override {
         assert(item.has_read());
         fence();
+        if (item.has_flag(slice_bit)) {
+            size_type first = slice_first(item.key<uint64_t>());
+            auto& hs = item.read_value<slice_type>();
+            for (size_type k = 0; k != hs.size(); ++k) {
+                if (!data_[first + k].v.cp_check(Sto::commit_tid(), hs[k])) {
+                    return false;
+                }
+            }
+            return true;
+        }
         history_type *hprev = item.read_value<history_type*>();
         return data_[item.key<size_type>()].v.cp_check(Sto::commit_tid(), hprev);
     }
@@ -151,6 +207,30 @@ public:
 private:
     typedef MvObject<T> object_type;
     typedef typename object_type::history_type history_type;
+    typedef std::vector<history_type*> slice_type;
+
+    static constexpr TransItem::flags_type slice_bit = TransItem::user0_bit;
+    // Distance, in elements, of the objects prefetched by slice reads
+    static constexpr size_type slice_prefetch = 8;
+    static_assert(N < (1U << 31), "TMvArray too large for slice keys");
+
+    // Element items are keyed by index; slice items by a key no index has
+    static uint64_t slice_key(size_type first, size_type last) {
+        return (uint64_t(1) << 63) | (uint64_t(first) << 32) | last;
+    }
+    static size_type slice_first(uint64_t key) {
+        return (key >> 32) & ((1U << 31) - 1);
+    }
+    // Prefetches the object slice_prefetch elements ahead, and the head
+    // version of the one halfway there, whose object should now be cached
+    void prefetch_slice(size_type i, size_type last) const {
+        if (i + slice_prefetch < last) {
+            __builtin_prefetch(&data_[i + slice_prefetch].v);
+        }
+        if (i + slice_prefetch / 2 < last) {
+            __builtin_prefetch(data_[i + slice_prefetch / 2].v.head());
+        }
+    }
 
     struct elem {
         object_type v;
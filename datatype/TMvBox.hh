@@ -25,7 +25,7 @@ public:
         else {
             history_type *h = v_.find(Sto::read_tid());
             MvAccess::template read<T>(item, h);
-            return {true, h->v()};
+            return {true, h->value()};
         }
     }
 
@@ -47,6 +47,10 @@ public:
     void write(Args&&... args) {
         Sto::item(this, 0).template add_write<T, Args...>(std::forward<Args>(args)...);
     }
+    // Blind update, installed as an MVCC delta
+    void commute(const comm_type& c) {
+        Sto::item(this, 0).add_commute(c);
+    }
 
     operator read_type() const {
         return read();
@@ -86,7 +90,7 @@ public:
     bool lock(TransItem& item, Transaction& txn) override {
         if (item.has_read()) {
             auto hprev = item.read_value<history_type*>();
-            if (Sto::commit_tid() < hprev->rtid()) {
+            if (v_.read_past(Sto::commit_tid(), hprev)) {
                 TransProxy(txn, item).add_write(nullptr);
                 return false;
             }
@@ -171,4 +175,12 @@ public:
         auto rtid = Sto::read_tid();
         return box.v_.find(rtid);
     }
+    template <typename T>
+    static MvHistory<T>* latest(const TMvBox<T> &box, bool wait) {
+        return box.v_.find_latest(wait);
+    }
+    template <typename T>
+    static void gc_table(TMvBox<T>& box, unsigned id) {
+        box.v_.gc_table(id);
+    }
 };
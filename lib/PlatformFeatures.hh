@@ -27,6 +27,7 @@ enum class Reg : int {eax = 0, ebx, ecx, edx, size};
 class CpuidQuery {
 public:
     static constexpr uint32_t query_level = 0;
+    static constexpr uint32_t query_subleaf = 0;
     static constexpr uint32_t result_bit = 0;
     static constexpr Reg result_reg = Reg::eax;
 };
@@ -45,25 +46,55 @@ public:
     static constexpr Reg result_reg = Reg::edx;
 };
 
+class OsXsaveQuery : public CpuidQuery {
+public:
+    static constexpr uint32_t query_level = 0x1;
+    static constexpr uint32_t result_bit = (1 << 27);
+    static constexpr Reg result_reg = Reg::ecx;
+};
+
+class Avx2Query : public CpuidQuery {
+public:
+    static constexpr uint32_t query_level = 0x7;
+    static constexpr uint32_t result_bit = (1 << 5);
+    static constexpr Reg result_reg = Reg::ebx;
+};
+
+class Avx512fQuery : public CpuidQuery {
+public:
+    static constexpr uint32_t query_level = 0x7;
+    static constexpr uint32_t result_bit = (1 << 16);
+    static constexpr Reg result_reg = Reg::ebx;
+};
+
 template <typename Query>
 inline bool cpu_has_feature() {
-    uint32_t max_level = __get_cpuid_max(0x80000000, nullptr);
+    // basic and extended leaves have separate maximum levels
+    uint32_t max_level = __get_cpuid_max(Query::query_level & 0x80000000, nullptr);
     if (max_level < Query::query_level) {
         return false;
     } else {
         uint32_t regs[static_cast<int>(Reg::size)];
-        int r = __get_cpuid(Query::query_level,
-                            &regs[static_cast<int>(Reg::eax)],
-                            &regs[static_cast<int>(Reg::ebx)],
-                            &regs[static_cast<int>(Reg::ecx)],
-                            &regs[static_cast<int>(Reg::edx)]);
-        if (r == 0)
-            return false;
-        else
-            return (regs[static_cast<int>(Query::result_reg)] & Query::result_bit);
+        __cpuid_count(Query::query_level, Query::query_subleaf,
+                      regs[static_cast<int>(Reg::eax)],
+                      regs[static_cast<int>(Reg::ebx)],
+                      regs[static_cast<int>(Reg::ecx)],
+                      regs[static_cast<int>(Reg::edx)]);
+        return (regs[static_cast<int>(Query::result_reg)] & Query::result_bit);
     }
 }
 
+// Whether the OS saves the vector state needed for AVX (YMM) or AVX-512
+// (YMM + opmask + ZMM) registers; the CPUID feature bits alone do not say.
+inline bool os_has_vector_state(bool avx512) {
+    if (!cpu_has_feature<OsXsaveQuery>())
+        return false;
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    uint32_t need = avx512 ? 0xe6 : 0x6;
+    return (eax & need) == need;
+}
+
 inline std::string get_cpu_brand_string() {
     uint32_t max_level = __get_cpuid_max(0x80000000, nullptr);
     if (max_level < level_bstr)
@@ -2,17 +2,26 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+
 #include "MVCCTypes.hh"
 
 namespace commutators {
 
+// Commutators are plain value types: MvHistory embeds one per version and
+// calls it directly, so none of them may be polymorphic.
 template <typename T>
 class Commutator {
 public:
     // Each type must define its own Commutator variant
     Commutator() = default;
 
-    virtual void operate(T&) const {
+    void operate(T&) const {
         always_assert(false, "Should never operate on the default commutator.");
     }
 };
@@ -29,16 +38,320 @@ public:
     Commutator() = default;
     explicit Commutator(int64_t delta) : delta(delta) {}
 
-    virtual bool is_blind_write() const {
-        return false;
+    void operate(int64_t& v) const {
+        v += delta;
     }
 
-    virtual void operate(int64_t& v) const {
-        v += delta;
+    // The deltas are summed first so the loop carries no dependency on v
+    static void operate_batch(int64_t& v, const Commutator<int64_t>* const* cs, unsigned n) {
+        int64_t sum = 0;
+        for (unsigned i = 0; i != n; ++i)
+            sum += cs[i]->delta;
+        v += sum;
     }
 
 private:
     int64_t delta;
 };
 
+static_assert(!std::is_polymorphic<Commutator<int64_t>>::value,
+              "commutators are stored without vtables");
+
+// Applies a run of `n` commutators to `v` in order. A commutator type may
+// provide a static `operate_batch(T&, const C* const*, unsigned)` that folds
+// the run more cheaply than one call per delta.
+template <typename C, typename = void>
+struct has_operate_batch : std::false_type {};
+template <typename C>
+struct has_operate_batch<C, std::void_t<decltype(&C::operate_batch)>> : std::true_type {};
+
+template <typename T, typename C>
+inline void operate_run(T& v, const C* const* cs, unsigned n) {
+    if constexpr (has_operate_batch<C>::value) {
+        C::operate_batch(v, cs, n);
+    } else {
+        for (unsigned i = 0; i != n; ++i)
+            cs[i]->operate(v);
+    }
+}
+
+
+//////////////////////////////////////////////
+//
+// Building blocks for typed commutators
+//
+// Each op is a blind update with `void operate(T&) const`. A value type
+// gets commutative updates by specializing Commutator<T> as a composition
+// of ops, for example:
+//
+//   template <>
+//   class Commutator<stats_row>
+//       : public compose<stats_row,
+//                        field_op<&stats_row::total, add_op<int64_t>>,
+//                        field_op<&stats_row::peak, max_op<int64_t>>> {
+//   public:
+//       using compose::compose;
+//   };
+//
+//   Commutator<stats_row>(add_op<int64_t>(n), max_op<int64_t>(n))
+//
+// The composition is resolved at compile time, so MVCC deltas and OCC
+// commutes apply it without virtual calls or read-set entries.
+//
+//////////////////////////////////////////////
+
+template <typename T>
+class add_op {
+public:
+    add_op() = default;
+    explicit add_op(T delta) : delta_(delta) {}
+
+    void operate(T& v) const {
+        v += delta_;
+    }
+
+private:
+    T delta_ = T();
+};
+
+// Adds `delta` but never goes below `floor`, e.g. a balance that may not
+// go negative. Meant for signed T.
+template <typename T>
+class floored_add_op {
+public:
+    floored_add_op() = default;
+    floored_add_op(T delta, T floor) : delta_(delta), floor_(floor) {}
+
+    void operate(T& v) const {
+        v = std::max<T>(v + delta_, floor_);
+    }
+
+private:
+    T delta_ = T();
+    T floor_ = std::numeric_limits<T>::lowest();
+};
+
+template <typename T>
+class min_op {
+public:
+    min_op() : x_(std::numeric_limits<T>::max()) {}
+    explicit min_op(T x) : x_(x) {}
+
+    void operate(T& v) const {
+        v = std::min(v, x_);
+    }
+
+private:
+    T x_;
+};
+
+template <typename T>
+class max_op {
+public:
+    max_op() : x_(std::numeric_limits<T>::lowest()) {}
+    explicit max_op(T x) : x_(x) {}
+
+    void operate(T& v) const {
+        v = std::max(v, x_);
+    }
+
+private:
+    T x_;
+};
+
+template <typename T>
+class or_op {
+public:
+    or_op() = default;
+    explicit or_op(T bits) : bits_(bits) {}
+
+    void operate(T& v) const {
+        v |= bits_;
+    }
+
+private:
+    T bits_ = T();
+};
+
+template <typename T>
+class and_op {
+public:
+    and_op() : bits_(~T()) {}
+    explicit and_op(T bits) : bits_(bits) {}
+
+    void operate(T& v) const {
+        v &= bits_;
+    }
+
+private:
+    T bits_;
+};
+
+// Applies `Op` to one member of a struct
+template <auto Member, typename Op>
+class field_op {
+public:
+    field_op() = default;
+    field_op(Op op) : op_(op) {}
+
+    template <typename R>
+    void operate(R& row) const {
+        op_.operate(row.*Member);
+    }
+
+private:
+    Op op_;
+};
+
+// Applies each op in turn
+template <typename T, typename... Ops>
+class compose {
+public:
+    compose() = default;
+    explicit compose(Ops... ops) : ops_(ops...) {}
+
+    void operate(T& v) const {
+        std::apply([&v](const auto&... op) { (op.operate(v), ...); }, ops_);
+    }
+
+private:
+    std::tuple<Ops...> ops_;
+};
+
+//////////////////////////////////////////////
+//
+// Value types with a built-in commutator
+//
+//////////////////////////////////////////////
+
+// The last N entries appended, oldest first
+template <typename T, unsigned N>
+class bounded_log {
+public:
+    static_assert(N > 0, "bounded_log needs room for an entry");
+
+    unsigned size() const {
+        return count_ < N ? count_ : N;
+    }
+    // Entries ever appended, including those pushed out
+    uint64_t total() const {
+        return count_;
+    }
+    const T& operator[](unsigned i) const {
+        return entries_[(count_ - size() + i) % N];
+    }
+    void append(const T& x) {
+        entries_[count_ % N] = x;
+        ++count_;
+    }
+
+private:
+    T entries_[N] = {};
+    uint64_t count_ = 0;
+};
+
+template <typename T, unsigned N>
+class append_op {
+public:
+    append_op() = default;
+    explicit append_op(const T& x) : x_(x), valid_(true) {}
+
+    void operate(bounded_log<T, N>& log) const {
+        if (valid_)
+            log.append(x_);
+    }
+
+private:
+    T x_ = T();
+    bool valid_ = false;
+};
+
+template <typename T, unsigned N>
+class Commutator<bounded_log<T, N>> : public append_op<T, N> {
+public:
+    using append_op<T, N>::append_op;
+};
+
+// HyperLogLog distinct-count sketch with 2^P one-byte registers
+template <unsigned P>
+class hyperloglog {
+public:
+    static_assert(P >= 4 && P <= 16, "hyperloglog precision out of range");
+    static constexpr unsigned nregisters = 1u << P;
+
+    // Register and rank for a well-mixed 64-bit hash
+    static unsigned register_of(uint64_t hash) {
+        return hash >> (64 - P);
+    }
+    static uint8_t rank_of(uint64_t hash) {
+        uint64_t w = hash << P;
+        return w ? __builtin_clzll(w) + 1 : 64 - P + 1;
+    }
+
+    void insert(unsigned reg, uint8_t rank) {
+        registers_[reg] = std::max(registers_[reg], rank);
+    }
+    void insert_hash(uint64_t hash) {
+        insert(register_of(hash), rank_of(hash));
+    }
+    void merge(const hyperloglog<P>& x) {
+        for (unsigned i = 0; i != nregisters; ++i)
+            insert(i, x.registers_[i]);
+    }
+
+    double estimate() const {
+        double m = nregisters;
+        double sum = 0;
+        unsigned zeros = 0;
+        for (auto r : registers_) {
+            sum += std::ldexp(1.0, -r);
+            zeros += (r == 0);
+        }
+        double e = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+        // small-range correction
+        if (e <= 2.5 * m && zeros)
+            e = m * std::log(m / zeros);
+        return e;
+    }
+
+private:
+    uint8_t registers_[nregisters] = {};
+};
+
+template <unsigned P>
+class hll_insert_op {
+public:
+    hll_insert_op() = default;
+    explicit hll_insert_op(uint64_t hash)
+        : reg_(hyperloglog<P>::register_of(hash)), rank_(hyperloglog<P>::rank_of(hash)) {}
+
+    void operate(hyperloglog<P>& h) const {
+        h.insert(reg_, rank_);
+    }
+
+private:
+    unsigned reg_ = 0;
+    uint8_t rank_ = 0;
+};
+
+template <unsigned P>
+class hll_merge_op {
+public:
+    hll_merge_op() = default;
+    explicit hll_merge_op(const hyperloglog<P>& x) : x_(x) {}
+
+    void operate(hyperloglog<P>& h) const {
+        h.merge(x_);
+    }
+
+private:
+    hyperloglog<P> x_;
+};
+
+template <unsigned P>
+class Commutator<hyperloglog<P>> : public hll_insert_op<P> {
+public:
+    using hll_insert_op<P>::hll_insert_op;
+};
+
 }
@@ -168,6 +168,7 @@ inline bool TVersion::observe_read_impl(TransItem &item, bool add_read){
         VersionDelegate::item_access_rdata(item).v = Packer<TVersion>::pack(t().buf_, std::move(version));
         //item().__or_flags(TransItem::read_bit);
         //item().rdata_ = Packer<TVersion>::pack(t()->buf_, std::move(version));
+        return t().note_read();
     }
 
     return true;
@@ -191,6 +192,7 @@ inline bool TNonopaqueVersion::observe_read_impl(TransItem& item, bool add_read)
         //item().__or_flags(TransItem::read_bit);
         //item().rdata_ = Packer<TNonopaqueVersion>::pack(t()->buf_, std::move(version));
         //t()->any_nonopaque_ = true;
+        return t().note_read();
     }
     return true;
 }
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Picks the epoch advancer period from observed reclamation pressure.
+// Pressure is the number of RCU callbacks still waiting to run and the
+// mean MVCC delta chain length seen by flattening; when either is high the
+// period shrinks so garbage is released sooner, and when both are low (or
+// nothing commits) it grows back to save advancer work.
+class EpochController {
+public:
+    struct params_type {
+        unsigned min_us = 100;
+        unsigned max_us = 100000;
+        uint64_t backlog_high = 1 << 20;  // pending RCU callbacks
+        uint64_t backlog_low = 1 << 16;
+        double chain_high = 64;           // mean versions per flatten run
+        double chain_low = 16;
+    };
+
+    struct sample_type {
+        uint64_t backlog;
+        double chain;       // 0 if MVCC flatten counters are unavailable
+        uint64_t commits;   // since the previous sample
+    };
+
+    EpochController(const params_type& params, unsigned initial_us)
+        : params_(params), period_(clamp(initial_us)) {
+    }
+
+    const params_type& params() const {
+        return params_;
+    }
+    unsigned period() const {
+        return period_;
+    }
+
+    unsigned update(const sample_type& s) {
+        if (s.backlog > params_.backlog_high || s.chain > params_.chain_high) {
+            // multiplicative decrease: react quickly to bursts
+            period_ = clamp(period_ / 2);
+        } else if (s.commits == 0
+                   || (s.backlog < params_.backlog_low && s.chain <= params_.chain_low)) {
+            period_ = clamp(period_ + std::max(period_ / 4, 1u));
+        }
+        return period_;
+    }
+
+private:
+    params_type params_;
+    unsigned period_;
+
+    unsigned clamp(unsigned us) const {
+        return std::min(std::max(us, params_.min_us), params_.max_us);
+    }
+};
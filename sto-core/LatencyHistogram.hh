@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// Log-linear histogram of TSC tick counts. Each power of two is split into
+// 8 linear sub-buckets, so any reported value is within 12.5% of the true
+// one. Values below 8 get exact buckets.
+class LatencyHistogram {
+public:
+    typedef uint64_t value_type;
+    static constexpr unsigned sub_bits = 3;
+    static constexpr unsigned sub_count = 1 << sub_bits;
+    static constexpr unsigned nbuckets = (64 - sub_bits + 1) * sub_count;
+
+    LatencyHistogram() {
+        reset();
+    }
+
+    static unsigned bucket(value_type v) {
+        if (v < sub_count)
+            return v;
+        unsigned msb = 63 - __builtin_clzll(v);
+        return (msb - sub_bits + 1) * sub_count + ((v >> (msb - sub_bits)) & (sub_count - 1));
+    }
+    // smallest value in bucket b
+    static value_type bucket_low(unsigned b) {
+        if (b < sub_count)
+            return b;
+        unsigned msb = b / sub_count + sub_bits - 1;
+        return value_type(sub_count + b % sub_count) << (msb - sub_bits);
+    }
+    // largest value in bucket b
+    static value_type bucket_high(unsigned b) {
+        return b + 1 == nbuckets ? ~value_type(0) : bucket_low(b + 1) - 1;
+    }
+
+    void record(value_type v) {
+        ++counts_[bucket(v)];
+        ++count_;
+        sum_ += v;
+        if (v > max_)
+            max_ = v;
+    }
+
+    void merge(const LatencyHistogram& x) {
+        for (unsigned b = 0; b != nbuckets; ++b)
+            counts_[b] += x.counts_[b];
+        count_ += x.count_;
+        sum_ += x.sum_;
+        if (x.max_ > max_)
+            max_ = x.max_;
+    }
+
+    void reset() {
+        for (unsigned b = 0; b != nbuckets; ++b)
+            counts_[b] = 0;
+        count_ = sum_ = max_ = 0;
+    }
+
+    uint64_t count() const {
+        return count_;
+    }
+    uint64_t count(unsigned b) const {
+        return counts_[b];
+    }
+    value_type max() const {
+        return max_;
+    }
+    double mean() const {
+        return count_ ? (double) sum_ / count_ : 0;
+    }
+
+    // Upper bound of the bucket holding the q-quantile (0 < q <= 1).
+    value_type quantile(double q) const {
+        if (!count_)
+            return 0;
+        uint64_t rank = uint64_t(q * count_ + 0.5);
+        if (rank == 0)
+            rank = 1;
+        uint64_t seen = 0;
+        for (unsigned b = 0; b != nbuckets; ++b) {
+            seen += counts_[b];
+            if (seen >= rank)
+                return bucket_high(b) < max_ ? bucket_high(b) : max_;
+        }
+        return max_;
+    }
+
+    // {"count":N,"mean":M,"p50":..,"p99":..,"p999":..,"max":..}; with
+    // buckets, also "buckets":[[low,high,count],...] for nonempty buckets.
+    void print_json(std::ostream& os, bool buckets) const {
+        os << "{\"count\":" << count_ << ",\"mean\":" << mean()
+           << ",\"p50\":" << quantile(0.5) << ",\"p90\":" << quantile(0.9)
+           << ",\"p99\":" << quantile(0.99) << ",\"p999\":" << quantile(0.999)
+           << ",\"max\":" << max_;
+        if (buckets) {
+            os << ",\"buckets\":[";
+            const char* sep = "";
+            for (unsigned b = 0; b != nbuckets; ++b)
+                if (counts_[b]) {
+                    os << sep << "[" << bucket_low(b) << "," << bucket_high(b)
+                       << "," << counts_[b] << "]";
+                    sep = ",";
+                }
+            os << "]";
+        }
+        os << "}";
+    }
+
+private:
+    uint64_t counts_[nbuckets];
+    uint64_t count_;
+    uint64_t sum_;
+    value_type max_;
+};
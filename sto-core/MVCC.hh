@@ -3,6 +3,6 @@
 #pragma once
 
 #include "MVCCAccess.hh"
-//#include "MVCCRegistry.hh"
+#include "MVCCRegistry.hh"
 #include "MVCCStructs.hh"
 #include "MVCCTypes.hh"
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "MVCCTypes.hh"
 #include "Transaction.hh"
 
@@ -13,4 +15,12 @@ public:
         it.__or_flags(TransItem::read_bit);
         it.rdata_.v = Packer<MvHistory<T>*>::pack(t.buf_, h);
     }
+    // Records the versions read by a multi-element read
+    template <typename T>
+    static void read_all(TransProxy item, std::vector<MvHistory<T>*> hs) {
+        Transaction &t = item.transaction();
+        TransItem &it = item.item();
+        it.__or_flags(TransItem::read_bit);
+        it.rdata_.v = Packer<std::vector<MvHistory<T>*>>::pack(t.buf_, std::move(hs));
+    }
 };
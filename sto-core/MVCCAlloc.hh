@@ -0,0 +1,69 @@
+// Pooled allocation for MVCC history nodes
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#ifndef MVCC_HISTORY_POOL
+#define MVCC_HISTORY_POOL 1
+#endif
+
+// Size-classed, per-thread free lists for MvHistory<T> nodes. Nodes are
+// carved from 64KB slabs and, once freed, reused by any type of the same
+// size class. RCU callbacks free nodes into the running thread's cache;
+// when a cache grows past 2 * batch_size nodes, batch_size of them move to
+// a global depot in one step, and a thread whose cache runs dry takes a
+// whole batch back before carving new memory. Slabs are kept for the life
+// of the process.
+class MvHistoryAllocator {
+public:
+    static constexpr size_t class_granularity = 64;
+    static constexpr unsigned nclasses = 16;  // nodes up to 1KB
+    static constexpr unsigned batch_size = 64;
+    static constexpr size_t slab_bytes = 64 << 10;
+
+    struct stats_type {
+        uint64_t hits;          // allocations served by a freed node
+        uint64_t misses;        // allocations carved from a slab
+        uint64_t depot_moves;   // batches moved to or from the depot
+        int64_t bytes_in_use;   // pooled bytes handed out and not freed
+        uint64_t slab_bytes;    // bytes reserved in slabs
+    };
+
+    static constexpr unsigned size_class(size_t size) {
+        return (size + class_granularity - 1) / class_granularity - 1;
+    }
+    static constexpr bool pooled_size(size_t size) {
+        return size_class(size) < nclasses;
+    }
+
+    // Pooling may only be switched before any history node is allocated,
+    // since nodes must be freed the same way they were allocated.
+    static void set_enabled(bool enabled);
+    static bool enabled() {
+        return enabled_;
+    }
+
+    static void* allocate(size_t size) {
+        if (enabled_ && pooled_size(size))
+            return pool_allocate(size_class(size));
+        return ::operator new(size, std::nothrow);
+    }
+    static void deallocate(void* p, size_t size) {
+        if (enabled_ && pooled_size(size))
+            pool_deallocate(p, size_class(size));
+        else
+            ::operator delete(p);
+    }
+
+    // Combined over live and exited threads; approximate while threads run.
+    static stats_type stats();
+
+private:
+    static bool enabled_;
+
+    static void* pool_allocate(unsigned sc);
+    static void pool_deallocate(void* p, unsigned sc);
+};
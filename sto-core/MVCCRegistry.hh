@@ -0,0 +1,255 @@
+// Background garbage collection for MVCC version chains
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Transaction.hh"
+
+// Registry of MvObjects with reclaimable history, drained by a background
+// collector thread.
+//
+// Without the collector, a committed version schedules the trim of the
+// versions below it in the committing thread's RCU set, and a run of
+// commutative deltas is only flattened when it grows past
+// MvObject::gc_flattening_length or is read. While the collector runs,
+// committing threads instead append an entry to a per-thread queue here:
+// one per committed version whose predecessors can be trimmed, and one per
+// object that starts a run of deltas. The collector trims a chain once the
+// entry's epoch is behind global_epochs.active_epoch, and flattens a delta
+// run once its object has gone a whole pass without a new delta, so objects
+// that stop being written do not keep their delta tails.
+//
+// Entries point at objects as gc_flatten_cb does, so an object may not be
+// freed until the entries made by its last commit have been visited; index
+// rows, which are freed two grace periods after their deleting commit, meet
+// this.
+//
+// The registry also counts, per table, the history elements allocated and
+// not yet freed. Objects are tagged with a table by MvObject::gc_table();
+// untagged objects count under table 0. With chain sampling on, every Nth
+// cp_install on a thread also walks the installed version's chain down to
+// the newest committed full version and records its length and the length
+// of the delta run on top of it.
+class MvRegistry {
+public:
+    typedef TRcuSet::epoch_type epoch_type;
+    typedef TransactionTid::type tid_type;
+    // Visits an entry; returns true to have it visited again next pass.
+    // `mark` starts at 0 and is kept between visits.
+    typedef bool (*collect_type)(void* p, tid_type& mark);
+
+    static constexpr unsigned max_tables = 32;
+    // Log2 buckets for sampled lengths: bucket 0 holds 0, bucket b > 0
+    // holds [2^(b-1), 2^b), and the last bucket is open-ended.
+    static constexpr unsigned length_buckets = 16;
+    // Sampled chains are walked no further than this
+    static constexpr unsigned chain_walk_limit = 1 << 14;
+
+    struct length_stats {
+        uint64_t total;
+        uint64_t max;
+        uint64_t buckets[length_buckets];
+
+        double mean(uint64_t samples) const {
+            return samples ? double(total) / samples : 0;
+        }
+    };
+
+    struct table_stats {
+        std::string name;
+        int64_t versions;  // history elements allocated and not yet freed
+        int64_t bytes;
+        uint64_t samples;  // sampled chains
+        length_stats chain;
+        length_stats delta_run;
+    };
+
+    // Returns the id of the named table, registering it on first use.
+    static unsigned table_id(const std::string& name);
+
+    static bool running() {
+        return running_.load(std::memory_order_relaxed);
+    }
+    // Starts the collector thread as TThread `thread_id`, which no other
+    // thread may use. Call before the workers start.
+    static void start(int thread_id);
+    // Stops the collector and visits every entry left behind once. Only
+    // safe when no transactions are running; rcu_release_all calls this.
+    static void stop();
+
+    // Queues an entry, stamped with the calling thread's write epoch.
+    static void enqueue(collect_type f, void* p) {
+        auto& thr = Transaction::this_thread();
+        auto& s = slots_[TThread::id()];
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.entries.push_back({f, p, thr.write_snapshot_epoch.load(std::memory_order_relaxed), 0});
+    }
+
+    static void account(unsigned table, int64_t nversions, int64_t nbytes) {
+        auto& s = slots_[TThread::id()];
+        s.versions[table].fetch_add(nversions, std::memory_order_relaxed);
+        s.bytes[table].fetch_add(nbytes, std::memory_order_relaxed);
+    }
+
+    // Samples every nth cp_install on each thread; 0, the default, turns
+    // sampling off. Call before the workers start.
+    static void set_chain_sampling(unsigned n) {
+        chain_sample_every_ = n;
+    }
+    // True on the calling thread's every nth call
+    static bool chain_sample_due() {
+        if (!chain_sample_every_)
+            return false;
+        auto& s = slots_[TThread::id()];
+        if (++s.sample_tick < chain_sample_every_)
+            return false;
+        s.sample_tick = 0;
+        return true;
+    }
+    // Records a chain of `length` versions whose newest `delta_run` are
+    // deltas
+    static void sample_chain(unsigned table, unsigned length, unsigned delta_run) {
+        auto& s = slots_[TThread::id()];
+        s.samples[table].fetch_add(1, std::memory_order_relaxed);
+        s.chain[table].record(length);
+        s.delta_run[table].record(delta_run);
+    }
+    static unsigned length_bucket(uint64_t n) {
+        unsigned b = n ? 64 - __builtin_clzll(n) : 0;
+        return b < length_buckets ? b : length_buckets - 1;
+    }
+
+    // Runs one collector pass on the calling thread, which must be
+    // registered with Transaction. Returns the number of entries visited.
+    static size_t collect_once();
+
+    // Entries queued or waiting for their epoch; approximate while running.
+    static size_t backlog();
+    // Combined over all threads; approximate while threads run.
+    static std::vector<table_stats> stats();
+    // Prints tables with retained history or samples; prints nothing if
+    // there are none.
+    static void print_stats(std::ostream& w);
+    // Same tables as a JSON array
+    static void print_json(std::ostream& w);
+
+private:
+    struct entry_type {
+        collect_type f;
+        void* p;
+        epoch_type epoch;
+        tid_type mark;
+    };
+
+    // Written only by the owning thread
+    struct length_counters {
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[length_buckets];
+
+        void record(uint64_t n) {
+            total.fetch_add(n, std::memory_order_relaxed);
+            if (n > max.load(std::memory_order_relaxed))
+                max.store(n, std::memory_order_relaxed);
+            buckets[length_bucket(n)].fetch_add(1, std::memory_order_relaxed);
+        }
+        void add_to(length_stats& st) const;
+    };
+
+    struct __attribute__((aligned(128))) slot_type {
+        std::mutex lock;
+        std::vector<entry_type> entries;
+        std::atomic<int64_t> versions[max_tables];
+        std::atomic<int64_t> bytes[max_tables];
+        unsigned sample_tick;
+        std::atomic<uint64_t> samples[max_tables];
+        length_counters chain[max_tables];
+        length_counters delta_run[max_tables];
+    };
+
+    static slot_type slots_[MAX_THREADS];
+    static unsigned chain_sample_every_;
+    static std::atomic<bool> running_;
+    static std::thread collector_;
+    static std::vector<entry_type> pending_;  // collector only
+    static std::atomic<size_t> npending_;
+
+    static void collector_main(int thread_id);
+    static void gather(std::vector<entry_type>& out);
+};
+
+// Worker threads that flatten hot runs of commutative deltas.
+//
+// Without the pool, an object whose delta run passes
+// MvObject::gc_flattening_length schedules gc_flatten_cb in the committing
+// thread's RCU set, and readers of the run flatten it themselves until the
+// next grace period. While the pool runs, the run is handed over sooner,
+// at MvObject::gc_eager_flattening_length, to a bounded queue that the
+// workers drain right away. When the queue is full the object falls back
+// to the RCU path. Queued objects must stay allocated as for gc_flatten_cb.
+// The pool makes that hold by stamping each entry with the enqueuing
+// thread's write epoch, as rcu_call would, and pinning the first worker's
+// epoch to the oldest stamp of the entries queued or being flattened, so
+// active_epoch cannot pass an entry before a worker is done with it.
+class MvFlattenPool {
+public:
+    typedef TRcuSet::epoch_type epoch_type;
+    typedef void (*flatten_type)(void* p);
+
+    static constexpr unsigned queue_capacity = 4096;
+
+    struct stats_type {
+        uint64_t flattened;  // queued objects handled by a worker
+        uint64_t overflows;  // objects sent to RCU because the queue was full
+    };
+
+    static bool running() {
+        return running_.load(std::memory_order_relaxed);
+    }
+    // Starts `nworkers` threads as TThreads `first_thread_id` and up, which
+    // no other thread may use, and waits for them to register. Call before
+    // the workers start.
+    static void start(int first_thread_id, unsigned nworkers);
+    // Stops the workers and runs whatever is still queued. Only safe when
+    // no transactions are running; rcu_release_all calls this.
+    static void stop();
+
+    // Returns false, and queues nothing, if the queue is full.
+    static bool enqueue(flatten_type f, void* p);
+
+    static size_t backlog();
+    static stats_type stats();
+
+private:
+    struct entry_type {
+        flatten_type f;
+        void* p;
+        epoch_type epoch;
+    };
+
+    static std::mutex lock_;
+    static std::condition_variable wake_;
+    static entry_type queue_[queue_capacity];
+    static unsigned head_;
+    static unsigned size_;
+    static std::atomic<bool> running_;
+    static std::vector<std::thread> workers_;
+    static unsigned nregistered_;
+    static int pin_thread_;
+    static epoch_type pin_;  // oldest entry epoch, or 0
+    static std::vector<epoch_type> running_epochs_;  // per worker, or 0
+    static std::atomic<uint64_t> nflattened_;
+    static std::atomic<uint64_t> noverflows_;
+
+    // The pin functions require lock_
+    static void set_pin(epoch_type epoch);
+    static void update_pin();
+    static void worker_main(int thread_id, unsigned index);
+};
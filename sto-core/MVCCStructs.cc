@@ -1,4 +1,12 @@
+#include <algorithm>
 #include <bitset>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
 
 #include "MVCCStructs.hh"
 
@@ -33,7 +41,7 @@ void MvHistoryBase::print_prevs(size_t max) const {
          ++i, h = h->prev_.load(std::memory_order_relaxed)) {
         std::cerr << i << ". " << (void*) h << " ";
         uintptr_t oaddr = reinterpret_cast<uintptr_t>(h->obj_);
-        if (reinterpret_cast<uintptr_t>(h) == oaddr + 24) {
+        if (reinterpret_cast<uintptr_t>(h) == oaddr + 32) {
             std::cerr << "INLINE ";
         }
         std::cerr << h->status_.load(std::memory_order_relaxed) << " W" << h->wtid_ << " R" << h->rtid_.load(std::memory_order_relaxed) << "\n";
@@ -47,3 +55,513 @@ void MvHistoryBase::assert_status_fail(const char* description) {
     assert(false);
 }
 #endif
+
+namespace {
+
+struct free_node {
+    free_node* next;
+};
+
+struct history_thread_cache;
+
+// Batches of freed nodes shared between threads, plus the registry of live
+// thread caches for MvHistoryAllocator::stats().
+struct history_pool_depot {
+    typedef std::pair<free_node*, unsigned> batch_type;
+
+    std::mutex lock;
+    std::vector<batch_type> batches[MvHistoryAllocator::nclasses];
+    std::vector<history_thread_cache*> caches;
+    MvHistoryAllocator::stats_type retired = {};
+};
+
+history_pool_depot& depot() {
+    static history_pool_depot d;
+    return d;
+}
+
+// Counters are written only by the owning thread.
+struct history_thread_cache {
+    static constexpr unsigned nclasses = MvHistoryAllocator::nclasses;
+
+    free_node* head[nclasses];
+    unsigned count[nclasses];
+    char* slab_next[nclasses];
+    char* slab_end[nclasses];
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> depot_moves;
+    std::atomic<int64_t> bytes_in_use;
+    std::atomic<uint64_t> slab_bytes;
+
+    history_thread_cache()
+        : head(), count(), slab_next(), slab_end(),
+          hits(0), misses(0), depot_moves(0), bytes_in_use(0), slab_bytes(0) {
+        auto& d = depot();
+        std::lock_guard<std::mutex> guard(d.lock);
+        d.caches.push_back(this);
+    }
+    ~history_thread_cache() {
+        auto& d = depot();
+        std::lock_guard<std::mutex> guard(d.lock);
+        for (unsigned sc = 0; sc != nclasses; ++sc)
+            if (head[sc])
+                d.batches[sc].emplace_back(head[sc], count[sc]);
+        accumulate(d.retired);
+        for (auto it = d.caches.begin(); it != d.caches.end(); ++it)
+            if (*it == this) {
+                d.caches.erase(it);
+                break;
+            }
+    }
+
+    template <typename T>
+    static void bump(std::atomic<T>& x, T delta) {
+        x.store(x.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    void accumulate(MvHistoryAllocator::stats_type& s) const {
+        s.hits += hits.load(std::memory_order_relaxed);
+        s.misses += misses.load(std::memory_order_relaxed);
+        s.depot_moves += depot_moves.load(std::memory_order_relaxed);
+        s.bytes_in_use += bytes_in_use.load(std::memory_order_relaxed);
+        s.slab_bytes += slab_bytes.load(std::memory_order_relaxed);
+    }
+
+    free_node* refill(unsigned sc) {
+        auto& d = depot();
+        std::lock_guard<std::mutex> guard(d.lock);
+        if (d.batches[sc].empty())
+            return nullptr;
+        std::tie(head[sc], count[sc]) = d.batches[sc].back();
+        d.batches[sc].pop_back();
+        bump(depot_moves, uint64_t(1));
+        return head[sc];
+    }
+
+    void spill(unsigned sc) {
+        free_node* first = head[sc];
+        free_node* last = first;
+        for (unsigned i = 1; i != MvHistoryAllocator::batch_size; ++i)
+            last = last->next;
+        head[sc] = last->next;
+        count[sc] -= MvHistoryAllocator::batch_size;
+        last->next = nullptr;
+        bump(depot_moves, uint64_t(1));
+        auto& d = depot();
+        std::lock_guard<std::mutex> guard(d.lock);
+        d.batches[sc].emplace_back(first, MvHistoryAllocator::batch_size);
+    }
+
+    void* carve(unsigned sc) {
+        size_t size = (sc + 1) * MvHistoryAllocator::class_granularity;
+        if (slab_end[sc] - slab_next[sc] < (ptrdiff_t) size) {
+            // the tail of the old slab, if any, is abandoned
+            void* slab = aligned_alloc(MvHistoryAllocator::class_granularity,
+                                       MvHistoryAllocator::slab_bytes);
+            if (!slab)
+                return nullptr;
+            slab_next[sc] = static_cast<char*>(slab);
+            slab_end[sc] = slab_next[sc] + MvHistoryAllocator::slab_bytes;
+            bump(slab_bytes, uint64_t(MvHistoryAllocator::slab_bytes));
+        }
+        void* p = slab_next[sc];
+        slab_next[sc] += size;
+        return p;
+    }
+};
+
+history_thread_cache& this_history_cache() {
+    static thread_local history_thread_cache c;
+    return c;
+}
+
+}
+
+bool MvHistoryAllocator::enabled_ = MVCC_HISTORY_POOL;
+
+void MvHistoryAllocator::set_enabled(bool enabled) {
+    auto s = stats();
+    always_assert(s.hits + s.misses == 0, "history nodes already allocated");
+    enabled_ = enabled;
+}
+
+void* MvHistoryAllocator::pool_allocate(unsigned sc) {
+    auto& c = this_history_cache();
+    free_node* n = c.head[sc];
+    if (!n)
+        n = c.refill(sc);
+    void* p;
+    if (n) {
+        c.head[sc] = n->next;
+        --c.count[sc];
+        c.bump(c.hits, uint64_t(1));
+        p = n;
+    } else if ((p = c.carve(sc))) {
+        c.bump(c.misses, uint64_t(1));
+    } else {
+        return nullptr;
+    }
+    c.bump(c.bytes_in_use, int64_t((sc + 1) * class_granularity));
+    return p;
+}
+
+void MvHistoryAllocator::pool_deallocate(void* p, unsigned sc) {
+    auto& c = this_history_cache();
+    auto n = static_cast<free_node*>(p);
+    n->next = c.head[sc];
+    c.head[sc] = n;
+    if (++c.count[sc] > 2 * batch_size)
+        c.spill(sc);
+    c.bump(c.bytes_in_use, -int64_t((sc + 1) * class_granularity));
+}
+
+MvHistoryAllocator::stats_type MvHistoryAllocator::stats() {
+    auto& d = depot();
+    std::lock_guard<std::mutex> guard(d.lock);
+    stats_type s = d.retired;
+    for (auto c : d.caches)
+        c->accumulate(s);
+    return s;
+}
+
+namespace {
+
+struct registry_tables {
+    std::mutex lock;
+    std::vector<std::string> names{"(untagged)"};
+};
+
+registry_tables& tables() {
+    static registry_tables t;
+    return t;
+}
+
+}
+
+MvRegistry::slot_type MvRegistry::slots_[MAX_THREADS];
+unsigned MvRegistry::chain_sample_every_;
+std::atomic<bool> MvRegistry::running_;
+std::thread MvRegistry::collector_;
+std::vector<MvRegistry::entry_type> MvRegistry::pending_;
+std::atomic<size_t> MvRegistry::npending_;
+
+unsigned MvRegistry::table_id(const std::string& name) {
+    auto& t = tables();
+    std::lock_guard<std::mutex> guard(t.lock);
+    for (unsigned i = 0; i != t.names.size(); ++i)
+        if (t.names[i] == name)
+            return i;
+    always_assert(t.names.size() < max_tables, "too many MVCC registry tables");
+    t.names.push_back(name);
+    return t.names.size() - 1;
+}
+
+void MvRegistry::start(int thread_id) {
+    always_assert(!running() && !collector_.joinable(), "MVCC collector already running");
+    running_.store(true);
+    collector_ = std::thread(&MvRegistry::collector_main, thread_id);
+}
+
+void MvRegistry::stop() {
+    running_.store(false);
+    if (collector_.joinable())
+        collector_.join();
+    // Nothing is running, so every entry can be visited now. A delta entry
+    // asks for a second visit before it flattens; give it one.
+    std::vector<entry_type> left;
+    left.swap(pending_);
+    gather(left);
+    for (auto& e : left)
+        while (e.f(e.p, e.mark)) {
+        }
+    npending_.store(0, std::memory_order_relaxed);
+}
+
+void MvRegistry::collector_main(int thread_id) {
+    TThread::set_id(thread_id);
+    Transaction::register_live_thread();
+    while (Transaction::global_epochs.run && running()) {
+        collect_once();
+        usleep(Transaction::get_epoch_cycle());
+    }
+}
+
+void MvRegistry::gather(std::vector<entry_type>& out) {
+    for (auto& s : slots_) {
+        std::lock_guard<std::mutex> guard(s.lock);
+        out.insert(out.end(), s.entries.begin(), s.entries.end());
+        s.entries.clear();
+    }
+}
+
+size_t MvRegistry::collect_once() {
+    auto& thr = Transaction::this_thread();
+    auto& ge = Transaction::global_epochs;
+    // Hold back active_epoch like a transaction would, so the versions
+    // visited below stay allocated; trims this pass defers land in this
+    // thread's RCU set.
+    thr.write_snapshot_epoch.store(ge.global_epoch.load(std::memory_order_acquire),
+                                   std::memory_order_release);
+    thr.epoch.store(ge.read_epoch.load(std::memory_order_acquire), std::memory_order_release);
+    auto ae = ge.active_epoch.load(std::memory_order_acquire);
+
+    gather(pending_);
+    std::vector<entry_type> next;
+    size_t nvisited = 0;
+    for (auto& e : pending_) {
+        if (TRcuSet::signed_epoch_type(e.epoch - ae) >= 0) {
+            next.push_back(e);
+        } else {
+            ++nvisited;
+            if (e.f(e.p, e.mark))
+                next.push_back(e);
+        }
+    }
+    pending_.swap(next);
+    npending_.store(pending_.size(), std::memory_order_relaxed);
+
+    thr.rcu_set.clean_until(ae);
+    thr.epoch.store(0, std::memory_order_release);
+    thr.write_snapshot_epoch.store(0, std::memory_order_release);
+    return nvisited;
+}
+
+size_t MvRegistry::backlog() {
+    size_t n = npending_.load(std::memory_order_relaxed);
+    for (auto& s : slots_) {
+        std::lock_guard<std::mutex> guard(s.lock);
+        n += s.entries.size();
+    }
+    return n;
+}
+
+void MvRegistry::length_counters::add_to(length_stats& st) const {
+    st.total += total.load(std::memory_order_relaxed);
+    st.max = std::max(st.max, uint64_t(max.load(std::memory_order_relaxed)));
+    for (unsigned b = 0; b != length_buckets; ++b)
+        st.buckets[b] += buckets[b].load(std::memory_order_relaxed);
+}
+
+std::vector<MvRegistry::table_stats> MvRegistry::stats() {
+    std::vector<table_stats> st;
+    {
+        auto& t = tables();
+        std::lock_guard<std::mutex> guard(t.lock);
+        for (auto& name : t.names) {
+            st.emplace_back();
+            st.back().name = name;
+        }
+    }
+    for (auto& s : slots_)
+        for (unsigned i = 0; i != st.size(); ++i) {
+            st[i].versions += s.versions[i].load(std::memory_order_relaxed);
+            st[i].bytes += s.bytes[i].load(std::memory_order_relaxed);
+            st[i].samples += s.samples[i].load(std::memory_order_relaxed);
+            s.chain[i].add_to(st[i].chain);
+            s.delta_run[i].add_to(st[i].delta_run);
+        }
+    return st;
+}
+
+void MvRegistry::print_stats(std::ostream& w) {
+    auto st = stats();
+    bool any = running() || backlog();
+    for (auto& t : st)
+        any = any || t.versions || t.bytes || t.samples;
+    if (!any)
+        return;
+    w << "MVCC retained history by table:\n";
+    for (auto& t : st) {
+        if (!t.versions && !t.bytes && !t.samples)
+            continue;
+        w << "  " << t.name << ": " << t.versions << " versions, "
+          << t.bytes << " bytes";
+        if (t.samples)
+            w << "; " << t.samples << " sampled chains, length mean "
+              << t.chain.mean(t.samples) << " max " << t.chain.max
+              << ", delta run mean " << t.delta_run.mean(t.samples)
+              << " max " << t.delta_run.max;
+        w << "\n";
+    }
+    if (running() || backlog())
+        w << "  collector backlog: " << backlog() << " entries\n";
+}
+
+namespace {
+
+void print_length_json(std::ostream& w, const MvRegistry::length_stats& st, uint64_t samples) {
+    w << "{\"mean\":" << st.mean(samples) << ",\"max\":" << st.max << ",\"buckets\":[";
+    const char* sep = "";
+    for (unsigned b = 0; b != MvRegistry::length_buckets; ++b)
+        if (st.buckets[b]) {
+            uint64_t low = b ? uint64_t(1) << (b - 1) : 0;
+            w << sep << "[" << low << ",";
+            if (b + 1 == MvRegistry::length_buckets)
+                w << "null";
+            else
+                w << (b ? (uint64_t(1) << b) - 1 : 0);
+            w << "," << st.buckets[b] << "]";
+            sep = ",";
+        }
+    w << "]}";
+}
+
+}
+
+// [{"table":..,"versions":..,"bytes":..,"samples":..,"chain":{..},
+//   "delta_run":{..}},...]; length objects are {"mean","max","buckets"},
+// buckets are [low,high,count] with a null high for the open bucket.
+void MvRegistry::print_json(std::ostream& w) {
+    w << "[";
+    const char* sep = "";
+    for (auto& t : stats()) {
+        if (!t.versions && !t.bytes && !t.samples)
+            continue;
+        w << sep << "{\"table\":\"" << t.name << "\",\"versions\":" << t.versions
+          << ",\"bytes\":" << t.bytes << ",\"samples\":" << t.samples << ",\"chain\":";
+        print_length_json(w, t.chain, t.samples);
+        w << ",\"delta_run\":";
+        print_length_json(w, t.delta_run, t.samples);
+        w << "}";
+        sep = ",";
+    }
+    w << "]";
+}
+
+std::mutex MvFlattenPool::lock_;
+std::condition_variable MvFlattenPool::wake_;
+MvFlattenPool::entry_type MvFlattenPool::queue_[queue_capacity];
+unsigned MvFlattenPool::head_;
+unsigned MvFlattenPool::size_;
+std::atomic<bool> MvFlattenPool::running_;
+std::vector<std::thread> MvFlattenPool::workers_;
+unsigned MvFlattenPool::nregistered_;
+int MvFlattenPool::pin_thread_;
+MvFlattenPool::epoch_type MvFlattenPool::pin_;
+std::vector<MvFlattenPool::epoch_type> MvFlattenPool::running_epochs_;
+std::atomic<uint64_t> MvFlattenPool::nflattened_;
+std::atomic<uint64_t> MvFlattenPool::noverflows_;
+
+void MvFlattenPool::start(int first_thread_id, unsigned nworkers) {
+    always_assert(!running() && workers_.empty(), "MVCC flatten pool already running");
+    always_assert(nworkers > 0, "MVCC flatten pool needs a worker");
+    std::unique_lock<std::mutex> guard(lock_);
+    nregistered_ = 0;
+    pin_thread_ = first_thread_id;
+    pin_ = 0;
+    running_epochs_.assign(nworkers, 0);
+    for (unsigned i = 0; i != nworkers; ++i)
+        workers_.emplace_back(&MvFlattenPool::worker_main, first_thread_id + i, i);
+    // The pin lives in the first worker's threadinfo, which the epoch
+    // advancer only reads once the worker is registered
+    wake_.wait(guard, [nworkers] { return nregistered_ == nworkers; });
+    running_.store(true);
+    guard.unlock();
+    wake_.notify_all();
+}
+
+void MvFlattenPool::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        running_.store(false);
+    }
+    wake_.notify_all();
+    for (auto& w : workers_)
+        w.join();
+    workers_.clear();
+    for (; size_; --size_, head_ = (head_ + 1) % queue_capacity)
+        queue_[head_].f(queue_[head_].p);
+    set_pin(0);
+}
+
+bool MvFlattenPool::enqueue(flatten_type f, void* p) {
+    epoch_type epoch = Transaction::this_thread().write_snapshot_epoch.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (size_ == queue_capacity) {
+            noverflows_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        queue_[(head_ + size_) % queue_capacity] = {f, p, epoch};
+        // Published before the calling transaction unpins its own epoch
+        if (!pin_ || TRcuSet::signed_epoch_type(epoch - pin_) < 0)
+            set_pin(epoch);
+        if (size_++)
+            return true;
+    }
+    wake_.notify_one();
+    return true;
+}
+
+void MvFlattenPool::set_pin(epoch_type epoch) {
+    pin_ = epoch;
+    Transaction::tinfo[pin_thread_].epoch.store(epoch);
+}
+
+void MvFlattenPool::update_pin() {
+    epoch_type epoch = 0;
+    auto older = [&epoch] (epoch_type e) {
+        if (e && (!epoch || TRcuSet::signed_epoch_type(e - epoch) < 0))
+            epoch = e;
+    };
+    for (unsigned i = 0; i != size_; ++i)
+        older(queue_[(head_ + i) % queue_capacity].epoch);
+    for (auto e : running_epochs_)
+        older(e);
+    set_pin(epoch);
+}
+
+void MvFlattenPool::worker_main(int thread_id, unsigned index) {
+    TThread::set_id(thread_id);
+    Transaction::register_live_thread();
+    auto& thr = Transaction::this_thread();
+    auto& ge = Transaction::global_epochs;
+    std::unique_lock<std::mutex> guard(lock_);
+    ++nregistered_;
+    wake_.notify_all();
+    wake_.wait(guard, [] { return running(); });
+    while (ge.run && running()) {
+        if (!size_) {
+            wake_.wait_for(guard, std::chrono::microseconds(Transaction::get_epoch_cycle()));
+            if (size_)
+                continue;
+        }
+        entry_type e {nullptr, nullptr, 0};
+        if (size_) {
+            e = queue_[head_];
+            head_ = (head_ + 1) % queue_capacity;
+            --size_;
+            running_epochs_[index] = e.epoch;
+        }
+        guard.unlock();
+
+        // The pin keeps e's object and the chain below it allocated; the
+        // trims a flatten defers land in this thread's RCU set.
+        thr.write_snapshot_epoch.store(ge.global_epoch.load(std::memory_order_acquire),
+                                       std::memory_order_release);
+        if (e.f) {
+            e.f(e.p);
+            nflattened_.fetch_add(1, std::memory_order_relaxed);
+        }
+        thr.rcu_set.clean_until(ge.active_epoch.load(std::memory_order_acquire));
+        thr.write_snapshot_epoch.store(0, std::memory_order_release);
+
+        guard.lock();
+        if (e.f) {
+            running_epochs_[index] = 0;
+            if (e.epoch == pin_)
+                update_pin();
+        }
+    }
+}
+
+size_t MvFlattenPool::backlog() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return size_;
+}
+
+MvFlattenPool::stats_type MvFlattenPool::stats() {
+    return {nflattened_.load(std::memory_order_relaxed),
+            noverflows_.load(std::memory_order_relaxed)};
+}
@@ -3,9 +3,11 @@
 #pragma once
 
 #include <deque>
-#include <stack>
 #include <thread>
+#include <vector>
 
+#include "MVCCAlloc.hh"
+#include "MVCCRegistry.hh"
 #include "MVCCTypes.hh"
 #include "Transaction.hh"
 #include "TRcu.hh"
@@ -43,8 +45,13 @@ public:
 
     MvHistoryBase() = delete;
     MvHistoryBase(void* obj, tid_type tid, MvStatus status)
-        : status_(status), wtid_(tid), rtid_(tid), prev_(nullptr),
-          obj_(obj) {
+        : status_(status), gc_table_(0), gc_state_(0), wtid_(tid), rtid_(tid),
+          prev_(nullptr), obj_(obj) {
+#if MVCC_FIND_SKIP
+        height_ = 0;
+        for (auto& s : skip_)
+            s = {nullptr, 0};
+#endif
     }
 
 #if NDEBUG
@@ -61,11 +68,54 @@ public:
 
     void print_prevs(size_t max = 1000) const;
 
+    // A committed non-delta version is reclaimed by the trim of a newer
+    // version, but its own trim of the versions below it may not have run
+    // yet: RCU callbacks from different threads run in no particular order.
+    // Each side sets its bit here, and the one that finishes second frees
+    // the version.
+    static constexpr uint8_t gc_trimmed = 1;
+    static constexpr uint8_t gc_superseded = 2;
+
+    // Returns true if the other side has already finished
+    bool gc_finish(uint8_t bit) {
+        return gc_state_.fetch_or(bit) & (bit ^ (gc_trimmed | gc_superseded));
+    }
+
     std::atomic<MvStatus> status_;  // Status of this element
+    uint16_t gc_table_;  // MvRegistry table this element is counted under
+    std::atomic<uint8_t> gc_state_;  // gc_trimmed | gc_superseded
     tid_type wtid_;  // Write TID
     std::atomic<tid_type> rtid_;  // Read TID
     std::atomic<MvHistoryBase*> prev_;
     void* obj_;  // Parent object
+
+#if MVCC_FIND_SKIP
+    // Skip directory for MvObject::find. Level k points to the newest older
+    // version whose height (position in the chain) is a multiple of
+    // 8^(k+1), so a lookup takes at most about 8 steps per level. The
+    // target's wtid is copied here so a reader can decide whether to jump
+    // without touching a version that may already be reclaimed.
+    struct skip_type {
+        MvHistoryBase* h;
+        tid_type wtid;
+    };
+    static constexpr unsigned skip_shift = 3;
+
+    // Called before linking this version directly above p.
+    void link_skips(MvHistoryBase* p) {
+        height_ = p->height_ + 1;
+        for (unsigned k = 0; k != MVCC_FIND_SKIP; ++k) {
+            unsigned mask = (1U << (skip_shift * (k + 1))) - 1;
+            if (!(p->height_ & mask))
+                skip_[k] = {p, p->wtid_};
+            else
+                skip_[k] = p->skip_[k];
+        }
+    }
+
+    unsigned height_;
+    skip_type skip_[MVCC_FIND_SKIP];
+#endif
 };
 
 template <typename T>
@@ -114,7 +164,11 @@ public:
     // Enqueues the deleted version for future cleanup
     inline void enqueue_for_committed() {
         assert_status((status() & COMMITTED_DELTA) == COMMITTED, "enqueue_for_committed");
-        Transaction::rcu_call(gc_committed_cb, this);
+        if (MvRegistry::running()) {
+            MvRegistry::enqueue(gc_collect_committed, this);
+        } else {
+            Transaction::rcu_call(gc_committed_cb, this);
+        }
     }
 
     // Retrieve the object for which this history element is intended
@@ -241,6 +295,22 @@ public:
         return &v_;
     }
 
+    // Returns a copy of the value. Unlike v(), never waits on a flatten
+    // running in another thread: a delta's value is computed from the
+    // chain here, and installed unless another flatten already holds it.
+    T value() {
+        int s = status_.load(std::memory_order_acquire);
+        if ((s & COMMITTED_DELTA) != COMMITTED_DELTA) {
+            return v_;
+        }
+        assert_status(!(s & ABORTED), "value not aborted");
+        T value = flattened_value();
+        if (!(s & LOCKED)) {
+            install_flattened(value, true);
+        }
+        return value;
+    }
+
     // Returns the current wtid
     inline tid_type wtid() const {
         return wtid_;
@@ -248,7 +318,8 @@ public:
 
 private:
     static void gc_committed_cb(void* ptr) {
-        history_type* h = static_cast<history_type*>(ptr);
+        history_type* hc = static_cast<history_type*>(ptr);
+        history_type* h = hc;
         h->assert_status((h->status() & COMMITTED_DELTA) == COMMITTED, "gc_committed_cb");
         // Here is how we ensure that `gc_committed_cb` never conflicts
         // with a flatten operation.
@@ -266,20 +337,37 @@ private:
             h = next;
             next = h->prev_relaxed();
             MvStatus status = h->status();
-#if MVCC_GARBAGE_DEBUG
-            h->assert_status(!(status & (GARBAGE | GARBAGE2)), "gc_committed_cb garbage tracking");
-            while (!(status & GARBAGE)
-                   && h->status_.compare_exchange_weak(status, MvStatus(status | GARBAGE))) {
-            }
-#endif
-            Transaction::rcu_call(gc_deleted_cb, h);
             h->assert_status(!(status & (LOCKED | PENDING)), "gc_committed_cb unlocked not pending");
             if ((status & COMMITTED_DELTA) == COMMITTED) {
+                // The initial version has no trim of its own
+                if (!next || h->gc_finish(gc_superseded)) {
+                    h->gc_delete();
+                }
                 break;
             }
+            h->gc_delete();
+        }
+        if (hc->gc_finish(gc_trimmed)) {
+            hc->gc_delete();
         }
     }
 
+    inline void gc_delete() {
+#if MVCC_GARBAGE_DEBUG
+        MvStatus status = this->status();
+        assert_status(!(status & (GARBAGE | GARBAGE2)), "gc_committed_cb garbage tracking");
+        while (!(status & GARBAGE)
+               && status_.compare_exchange_weak(status, MvStatus(status | GARBAGE))) {
+        }
+#endif
+        Transaction::rcu_call(gc_deleted_cb, this);
+    }
+
+    static bool gc_collect_committed(void* ptr, tid_type&) {
+        gc_committed_cb(ptr);
+        return false;
+    }
+
     static void gc_deleted_cb(void* ptr) {
         history_type* h = static_cast<history_type*>(ptr);
         MvStatus status = h->status_.load(std::memory_order_relaxed);
@@ -310,11 +398,49 @@ private:
     // To be called from the source of the flattening.
     void flatten(int old_status, bool fg) {
         assert(old_status == COMMITTED_DELTA);
+        install_flattened(flattened_value(), fg);
+    }
+
+    // Flatten traces up to this long stay on the stack
+    static constexpr unsigned flatten_trace_capacity = 128;
 
+    // LIFO of history elements still to be applied by a flatten
+    class flatten_trace {
+    public:
+        bool empty() const {
+            return n_ == 0;
+        }
+        void push(history_type* h) {
+            if (n_ < flatten_trace_capacity)
+                local_[n_] = h;
+            else
+                spill_.push_back(h);
+            ++n_;
+        }
+        history_type* top() const {
+            return n_ > flatten_trace_capacity ? spill_.back() : local_[n_ - 1];
+        }
+        void pop() {
+            if (n_ > flatten_trace_capacity)
+                spill_.pop_back();
+            --n_;
+        }
+    private:
+        unsigned n_ = 0;
+        history_type* local_[flatten_trace_capacity];
+        std::vector<history_type*> spill_;
+    };
+
+    // Consecutive deltas applied by one commutators::operate_run call
+    static constexpr unsigned flatten_batch_size = MVCC_FLATTEN_BATCH ? 32 : 1;
+
+    // Computes the value of this delta from the chain below it, without
+    // changing the element itself.
+    T flattened_value() {
         // Current element is the one initiating the flattening here. It is not
         // included in the trace, but it is included in the committed trace.
         history_type* curr = this;
-        std::stack<history_type*> trace;  // Of history elements to process
+        flatten_trace trace;  // Of history elements to process
 
         while (!curr->status_is(COMMITTED_DELTA, COMMITTED)) {
             trace.push(curr);
@@ -325,6 +451,8 @@ private:
         T value {curr->v_};
         tid_type safe_wtid = curr->wtid();
         curr->update_rtid(this->wtid());
+        const comm_type* run[flatten_batch_size];  // deltas not yet applied
+        unsigned nrun = 0;
 
         while (!trace.empty()) {
             auto hnext = trace.top();
@@ -344,8 +472,13 @@ private:
                 hnext->update_rtid(this->wtid());
                 assert(!(status & DELETED));
                 if (status & DELTA) {
-                    hnext->c_.operate(value);
+                    run[nrun++] = &hnext->c_;
+                    if (nrun == flatten_batch_size) {
+                        commutators::operate_run(value, run, nrun);
+                        nrun = 0;
+                    }
                 } else {
+                    nrun = 0;
                     value = hnext->v_;
                 }
             }
@@ -353,7 +486,11 @@ private:
             trace.pop();
             safe_wtid = hnext->wtid();
         }
+        commutators::operate_run(value, run, nrun);
+        return value;
+    }
 
+    void install_flattened(const T& value, bool fg) {
         auto expected = COMMITTED_DELTA;
         if (status_.compare_exchange_strong(expected, LOCKED_COMMITTED_DELTA)) {
             v_ = value;
@@ -383,45 +520,47 @@ public:
 
     // How many consecutive DELTA versions will be allowed before flattening
     static constexpr int gc_flattening_length = 257;
+    // The same, while MvFlattenPool runs
+    static constexpr int gc_eager_flattening_length = 32;
 
 #if MVCC_INLINING
-    MvObject() : h_(&ih_), ih_(this) {
+    MvObject() : h_(&ih_), latest_(&ih_), ih_(this) {
         if (std::is_trivial<T>::value) {
             ih_.v_ = T();
         }
         ih_.status(COMMITTED_DELETED);
     }
     explicit MvObject(const T& value)
-            : h_(&ih_), ih_(this, 0, value) {
+            : h_(&ih_), latest_(&ih_), ih_(this, 0, value) {
         ih_.status(COMMITTED);
     }
     explicit MvObject(T&& value)
-            : h_(&ih_), ih_(this, 0, std::move(value)) {
+            : h_(&ih_), latest_(&ih_), ih_(this, 0, std::move(value)) {
         ih_.status(COMMITTED);
     }
     template <typename... Args>
     explicit MvObject(Args&&... args)
-            : h_(&ih_), ih_(this, 0, T(std::forward<Args>(args)...)) {
+            : h_(&ih_), latest_(&ih_), ih_(this, 0, T(std::forward<Args>(args)...)) {
         ih_.status(COMMITTED);
     }
 #else
-    MvObject() : h_(new history_type(this)) {
+    MvObject() : h_(alloc_history(0, this)), latest_(h_.load(std::memory_order_relaxed)) {
         if (std::is_trivial<T>::value) {
             head()->v_ = T(); /* XXXX */
         }
         head()->status(COMMITTED_DELETED);
     }
     explicit MvObject(const T& value)
-            : h_(new history_type(this, 0, value)) {
+            : h_(alloc_history(0, this, 0, value)), latest_(h_.load(std::memory_order_relaxed)) {
         head()->status(COMMITTED);
     }
     explicit MvObject(T&& value)
-            : h_(new history_type(this, 0, std::move(value))) {
+            : h_(alloc_history(0, this, 0, std::move(value))), latest_(h_.load(std::memory_order_relaxed)) {
         head()->status(COMMITTED);
     }
     template <typename... Args>
     explicit MvObject(Args&&... args)
-            : h_(new history_type(this, 0, T(std::forward<Args>(args)...))) {
+            : h_(alloc_history(0, this, 0, T(std::forward<Args>(args)...))), latest_(h_.load(std::memory_order_relaxed)) {
         head()->status(COMMITTED);
     }
 #endif
@@ -464,9 +603,13 @@ public:
                 target = &t->prev_;
             } else if (!(t->status_.load(std::memory_order_acquire) & ABORTED)
                        && t->rtid_.load(std::memory_order_acquire) > tid) {
+                lease_conflict(t->rtid_.load(std::memory_order_relaxed));
                 return false;
             } else {
                 // Properly link h's prev_
+#if MVCC_FIND_SKIP
+                hw->link_skips(t);
+#endif
                 hw->prev_.store(t, std::memory_order_release);
 
                 // Attempt to CAS onto the target
@@ -491,6 +634,9 @@ public:
         for (h = hw->prev(); h; h = h->prev()) {
             if ((may_commute && !h->can_precede(hw))
                 || (h->status_is(COMMITTED) && h->rtid() > tid)) {
+                if (h->status_is(COMMITTED) && h->rtid() > tid) {
+                    lease_conflict(h->rtid());
+                }
                 hw->status_abort(ABORTED_WV2);
                 return false;
             }
@@ -507,11 +653,30 @@ public:
         }
     }
 
+    // True if hr, the version a read-modify-write read, has been read past
+    // tid, so a write at tid must abort
+    bool read_past(const tid_type tid, history_type* hr) {
+        tid_type rtid = hr->rtid();
+        if (tid < rtid) {
+            lease_conflict(rtid);
+            return true;
+        }
+        return false;
+    }
+
     // "Check" step: read timestamp updates and version consistency check;
     //               returns true if successful, false is aborted
     bool cp_check(const tid_type tid, history_type* hr) {
-        // rtid update
-        hr->update_rtid(tid);
+        // rtid update, unless a lease already covers tid
+        TXP_INCREMENT(txp_mvcc_rtid_checks);
+        if (hr->rtid() < tid) {
+            TXP_INCREMENT(txp_mvcc_rtid_writes);
+            if (lease_off_.load(std::memory_order_relaxed)) {
+                hr->update_rtid(tid);
+            } else {
+                hr->update_rtid(tid + Transaction::mvcc_read_lease());
+            }
+        }
 
         // Read version consistency check
         for (history_type* h = head(); h != hr; h = h->prev()) {
@@ -528,23 +693,69 @@ public:
         int s = h->status();
         h->assert_status((s & (PENDING | ABORTED)) == PENDING, "cp_install");
         h->status((s & ~PENDING) | COMMITTED);
+        if (lease_off_.load(std::memory_order_relaxed)) {
+            lease_off_.store(false, std::memory_order_relaxed);
+        }
+        publish_latest(h);
+        if (MvRegistry::chain_sample_due()) {
+            sample_chain(h);
+        }
         if (!(s & DELTA)) {
             cuctr_.store(0, std::memory_order_relaxed);
             flattenv_.store(0, std::memory_order_relaxed);
             h->enqueue_for_committed();
         } else {
+            if (MvRegistry::running() && !gc_tracked_.exchange(true)) {
+                MvRegistry::enqueue(gc_collect_deltas, this);
+            }
+            bool pooled = MvFlattenPool::running();
             int dc = cuctr_.load(std::memory_order_relaxed) + 1;
-            if (dc <= gc_flattening_length) {
+            if (dc <= (pooled ? gc_eager_flattening_length : gc_flattening_length)) {
                 cuctr_.store(dc, std::memory_order_relaxed);
             } else if (flattenv_.load(std::memory_order_relaxed) == 0) {
                 cuctr_.store(0, std::memory_order_relaxed);
                 flattenv_.store(h->wtid(), std::memory_order_relaxed);
-                Transaction::rcu_call(gc_flatten_cb, this);
+                if (!pooled || !MvFlattenPool::enqueue(gc_flatten_cb, this)) {
+                    Transaction::rcu_call(gc_flatten_cb, this);
+                }
+            }
+        }
+    }
+
+    // A writer at tid found a read at rtid above it. If that read may be a
+    // lease, stop leasing this object until a write gets through, and move
+    // the TID counter past rtid so the writer's retry is not below it again.
+    void lease_conflict(tid_type rtid) {
+        if (Transaction::mvcc_read_lease()) {
+            lease_off_.store(true, std::memory_order_relaxed);
+            Transaction::mvcc_skip_tids(rtid);
+        }
+    }
+
+    // Reports the chain below h, down to the newest committed full version,
+    // to MvRegistry's chain statistics. The walk must stop there: older
+    // versions may already have been collected, and GC leaves prev_ set.
+    void sample_chain(history_type* h) {
+        unsigned length = 0, delta_run = 0;
+        bool in_run = true;
+        for (; h && length != MvRegistry::chain_walk_limit; h = h->prev()) {
+            ++length;
+            if (h->status_is(ABORTED)) {
+                continue;
+            }
+            if (in_run && h->status_is(DELTA)) {
+                ++delta_run;
+            } else {
+                in_run = false;
+                if (h->status_is(COMMITTED) && !h->status_is(DELTA)) {
+                    break;
+                }
             }
         }
+        MvRegistry::sample_chain(gc_table_, length, delta_run);
     }
 
-    // Deletes the history element if it was new'ed, or set it as UNUSED if it
+    // Frees the history element if it was allocated, or set it as UNUSED if it
     // is the inlined version
     // !!! IMPORTANT !!!
     // This function should only be used to free history nodes that have NOT been
@@ -553,10 +764,7 @@ public:
         if (is_inlined(h)) {
             h->status_.store(UNUSED, std::memory_order_release);
         } else {
-#if MVCC_GARBAGE_DEBUG
-            memset(h, 0xFF, sizeof(MvHistoryBase));
-#endif
-            delete h;
+            free_history(h);
         }
     }
 
@@ -566,7 +774,9 @@ public:
     history_type* find(const tid_type tid, const bool wait=true) const {
         history_type* h = head();
 
-        /* TODO: use something smarter than a linear scan */
+#if MVCC_FIND_SKIP
+        h = skip_newer_than(h, tid);
+#endif
         while (h) {
             auto status = h->status();
             auto wtid = h->wtid();
@@ -596,7 +806,15 @@ public:
     }
 
     history_type* find_latest(const bool wait = true) const {
-        history_type* h = head();
+        history_type* h = latest();
+        if (!wait) {
+            return h;
+        }
+        // pending versions above the cached one must be waited out
+        if (h == head()) {
+            return h;
+        }
+        h = head();
         while (true) {
             auto status = h->status();
             h->assert_status(status & (PENDING | ABORTED | COMMITTED), "find_latest");
@@ -604,12 +822,27 @@ public:
                 h->wait_if_pending(status);
             }
             if (status & COMMITTED) {
+                // so a later find_latest(false) cannot return an older one
+                publish_latest(h);
                 return h;
             }
             h = h->prev();
         }
     }
 
+    // Counts this object's history under MvRegistry table `id`. Call before
+    // the object is shared.
+    void gc_table(unsigned id) {
+        gc_table_ = id;
+        for (history_type* h = head(); h; h = h->prev()) {
+            if (!is_inlined(h)) {
+                MvRegistry::account(h->gc_table_, -1, -int64_t(sizeof(history_type)));
+                MvRegistry::account(id, 1, sizeof(history_type));
+                h->gc_table_ = id;
+            }
+        }
+    }
+
     // Returns whether the given history element is the inlined version
     inline bool is_inlined(const history_type* h) const {
 #if MVCC_INLINING
@@ -634,45 +867,30 @@ public:
             return &ih_;
         }
 #endif
-        return new(std::nothrow) history_type(this, std::forward<Args>(args)...);
+        return alloc_history(gc_table_, this, std::forward<Args>(args)...);
+    }
+
+    // Newest committed version (possibly a delta); a single acquire load
+    history_type* latest() const {
+        return reinterpret_cast<history_type*>(latest_.load(std::memory_order_acquire));
     }
 
     // Read-only
     const T& nontrans_access() const {
-        history_type* h = head();
-        history_type* next = nullptr;
-        /* TODO: head version caching */
-        while (h) {
-            if (h->status_is(COMMITTED)) {
-                if (h->status_is(DELTA)) {
-                    h->enflatten();
-                }
-                return h->v();
-            }
-            next = h;
-            h = next->prev();
+        history_type* h = latest();
+        if (h->status_is(DELTA)) {
+            h->enflatten();
         }
-        // Should never get here!
-        throw InvalidState();
+        return h->v();
     }
     // Writable version
     T& nontrans_access() {
-        history_type* h = head();
-        history_type* next = nullptr;
-        /* TODO: head version caching */
-        while (h) {
-            if (h->status_is(COMMITTED)) {
-                if (h->status_is(DELTA)) {
-                    h->enflatten();
-                }
-                h->status(COMMITTED);
-                return h->v();
-            }
-            next = h;
-            h = next->prev();
+        history_type* h = latest();
+        if (h->status_is(DELTA)) {
+            h->enflatten();
         }
-        // Should never get here!
-        throw InvalidState();
+        h->status(COMMITTED);
+        return h->v();
     }
 
 protected:
@@ -696,8 +914,84 @@ protected:
         }
     }
 
+    // MvRegistry visit for an object with a run of deltas: flattens the
+    // newest delta once a whole pass has gone by without another one.
+    static bool gc_collect_deltas(void* ptr, tid_type& mark) {
+        auto object = static_cast<MvObject<T>*>(ptr);
+        history_type* h = object->latest();
+        if (h->status_is(DELTA) && h->wtid() != mark) {
+            mark = h->wtid();
+            return true;
+        }
+        object->gc_tracked_.store(false);
+        int status = h->status();
+        if (status == COMMITTED_DELTA) {
+            h->flatten(status, false);
+        }
+        // a delta committed while the flag was still set was not queued
+        history_type* hl = object->latest();
+        if (hl != h && hl->status_is(DELTA) && !object->gc_tracked_.exchange(true)) {
+            mark = 0;
+            return true;
+        }
+        return false;
+    }
+
+#if MVCC_FIND_SKIP
+    // Jumps over versions with wtid > tid. Only targets newer than tid are
+    // followed: they are above the visible version, so they are still live,
+    // while anything below it may already have been reclaimed.
+    static history_type* skip_newer_than(history_type* h, const tid_type tid) {
+        for (int k = MVCC_FIND_SKIP - 1; k >= 0; --k) {
+            while (h->skip_[k].h && h->skip_[k].wtid > tid) {
+                h = static_cast<history_type*>(h->skip_[k].h);
+            }
+        }
+        return h;
+    }
+#endif
+
+    // Makes h the cached latest version unless a newer one was installed
+    // first. Must run before h is enqueued for GC: a cached version is only
+    // reclaimed after latest_ has moved past it. Readers may also publish a
+    // committed version they found above the cached one.
+    void publish_latest(history_type* h) const {
+        MvHistoryBase* cur = latest_.load(std::memory_order_acquire);
+        while (cur->wtid_ < h->wtid()
+               && !latest_.compare_exchange_weak(cur, h, std::memory_order_release,
+                                                 std::memory_order_acquire)) {
+        }
+    }
+
+    // Non-inlined history elements come from MvHistoryAllocator and are
+    // counted under MvRegistry table `table`
+    template <typename... Args>
+    static history_type* alloc_history(unsigned table, Args&&... args) {
+        static_assert(alignof(history_type) <= MvHistoryAllocator::class_granularity,
+                      "history element alignment exceeds pool alignment");
+        void* p = MvHistoryAllocator::allocate(sizeof(history_type));
+        if (!p)
+            return nullptr;
+        auto h = new (p) history_type(std::forward<Args>(args)...);
+        h->gc_table_ = table;
+        MvRegistry::account(table, 1, sizeof(history_type));
+        return h;
+    }
+    static void free_history(history_type* h) {
+        MvRegistry::account(h->gc_table_, -1, -int64_t(sizeof(history_type)));
+        h->~history_type();
+#if MVCC_GARBAGE_DEBUG
+        memset(h, 0xFF, sizeof(MvHistoryBase));
+#endif
+        MvHistoryAllocator::deallocate(h, sizeof(history_type));
+    }
+
     std::atomic<MvHistoryBase*> h_;
+    mutable std::atomic<MvHistoryBase*> latest_;  // Newest committed version
     std::atomic<int> cuctr_ = 0;  // For gc-time flattening
+    uint16_t gc_table_ = 0;  // MvRegistry table for new history elements
+    std::atomic<bool> gc_tracked_ = false;  // Delta run queued with MvRegistry
+    std::atomic<bool> lease_off_ = false;  // A read lease aborted a writer
     std::atomic<tid_type> flattenv_;
 
 #if MVCC_INLINING
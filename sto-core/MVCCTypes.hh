@@ -21,3 +21,13 @@ template <typename T> class MvObject;
 #ifndef MVCC_INLINING
 #define MVCC_INLINING 0
 #endif
+
+// Number of skip levels kept per version for MvObject::find (0 disables)
+#ifndef MVCC_FIND_SKIP
+#define MVCC_FIND_SKIP 0
+#endif
+
+// Flatten hands runs of consecutive deltas to commutators::operate_run
+#ifndef MVCC_FLATTEN_BATCH
+#define MVCC_FLATTEN_BATCH 1
+#endif
@@ -1,9 +1,10 @@
 #include "TRcu.hh"
 
+#include <algorithm>
 #include <limits>
 
 TRcuSet::TRcuSet()
-    : clean_epoch_(0) {
+    : clean_epoch_(0), free_(nullptr), nadded_(0), nrun_(0) {
     unsigned capacity = (4080 - sizeof(TRcuGroup)) / sizeof(TRcuGroup::TRcuElement);
     current_ = first_ = TRcuGroup::make(capacity);
     // ngroups_ = 1;
@@ -15,6 +16,12 @@ TRcuSet::~TRcuSet() {
         TRcuGroup::free(first_);
         first_ = next;
     }
+    TRcuGroup* g = free_.exchange(nullptr);
+    while (g) {
+        TRcuGroup* next = g->next_;
+        TRcuGroup::free(g);
+        g = next;
+    }
     current_ = nullptr;
     // ngroups_ = 0;
 }
@@ -41,23 +48,36 @@ void TRcuSet::check() {
     // assert(ngroups_ > 0);
 }
 
+TRcuGroup* TRcuSet::new_group() {
+    TRcuGroup* g = free_.load(std::memory_order_relaxed);
+    if (g) {
+        // take every recycled group at once; keep the rest as spares
+        g = free_.exchange(nullptr, std::memory_order_acquire);
+        return g;
+    }
+    unsigned capacity = (16368 - sizeof(TRcuGroup)) / sizeof(TRcuGroup::TRcuElement);
+    g = TRcuGroup::make(capacity);
+    g->next_ = nullptr;
+    return g;
+}
+
 void TRcuSet::grow() {
     if (!current_->next_) {
-        unsigned capacity = (16368 - sizeof(TRcuGroup)) / sizeof(TRcuGroup::TRcuElement);
-        current_->next_ = TRcuGroup::make(capacity);
+        current_->next_ = new_group();
         // ++ngroups_;
     }
     current_ = current_->next_;
     assert(current_->head_ == 0 && current_->tail_ == 0);
 }
 
-inline bool TRcuGroup::clean_until(epoch_type max_epoch) {
+inline bool TRcuGroup::clean_until(epoch_type max_epoch, uint64_t& nrun) {
     while (head_ != tail_
            && signed_epoch_type(max_epoch - e_[head_].u.epoch) > 0) {
         ++head_;
         while (head_ != tail_ && e_[head_].function) {
             e_[head_].function(e_[head_].u.argument);
             ++head_;
+            ++nrun;
         }
     }
     if (head_ == tail_) {
@@ -71,21 +91,85 @@ inline bool TRcuGroup::clean_until(epoch_type max_epoch) {
 void TRcuSet::hard_clean_until(epoch_type max_epoch) {
     TRcuGroup* empty_head = nullptr;
     TRcuGroup* empty_tail = nullptr;
+    uint64_t nrun = 0;
     // clean [first_, current_]
-    while (first_->clean_until(max_epoch)) {
+    while (first_->clean_until(max_epoch, nrun)) {
         if (!empty_head) {
             empty_head = first_;
         }
         empty_tail = first_;
         if (first_ == current_) {
             first_ = current_ = empty_head;
+            account_run(nrun);
             return;
         }
         first_ = first_->next_;
     }
+    account_run(nrun);
     // hook empties after current_; everything after current_ guaranteed empty
     if (empty_head) {
         empty_tail->next_ = current_->next_;
         current_->next_ = empty_head;
     }
 }
+
+TRcuBatch* TRcuSet::hard_hand_off() {
+    // everything after current_ is empty and stays with this set
+    TRcuGroup* spare = current_->next_;
+    current_->next_ = nullptr;
+    TRcuBatch* b = new TRcuBatch{first_, this, read_tsc(), nullptr};
+    first_ = current_ = spare ? spare : new_group();
+    return b;
+}
+
+TRcuReclaimer::stats_type TRcuReclaimer::reclaim_until(epoch_type max_epoch) {
+    stats_type stats = {0, 0, 0, 0};
+
+    // inbox is LIFO; reverse it so older batches are cleaned first
+    TRcuBatch* in = inbox_.exchange(nullptr, std::memory_order_acquire);
+    TRcuBatch* fifo = nullptr;
+    while (in) {
+        TRcuBatch* next = in->next_;
+        in->next_ = fifo;
+        fifo = in;
+        in = next;
+    }
+    if (fifo) {
+        if (pending_tail_)
+            pending_tail_->next_ = fifo;
+        else
+            pending_ = fifo;
+        while (fifo->next_)
+            fifo = fifo->next_;
+        pending_tail_ = fifo;
+    }
+
+    TRcuBatch** pprev = &pending_;
+    TRcuBatch* last = nullptr;
+    uint64_t now = read_tsc();
+    while (TRcuBatch* b = *pprev) {
+        TRcuGroup* g = b->first_;
+        uint64_t nrun = 0;
+        while (g && g->clean_until(max_epoch, nrun)) {
+            TRcuGroup* next = g->next_;
+            b->owner_->recycle(g);
+            g = next;
+        }
+        b->owner_->account_run(nrun);
+        b->first_ = g;
+        if (g) {
+            ++stats.backlog;
+            last = b;
+            pprev = &b->next_;
+        } else {
+            uint64_t latency = now - b->handoff_tsc_;
+            ++stats.reclaimed;
+            stats.latency_tsc += latency;
+            stats.max_latency_tsc = std::max(stats.max_latency_tsc, latency);
+            *pprev = b->next_;
+            delete b;
+        }
+    }
+    pending_tail_ = last;
+    return stats;
+}
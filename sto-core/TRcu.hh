@@ -1,6 +1,7 @@
 #pragma once
 
 #include <new>
+#include <atomic>
 #include "compiler.hh"
 #include <assert.h>
 
@@ -60,7 +61,18 @@ public:
         ++tail_;
     }
 
-    inline bool clean_until(epoch_type max_epoch);
+    inline bool clean_until(epoch_type max_epoch, uint64_t& nrun);
+};
+
+class TRcuSet;
+
+// A chain of groups detached from a thread's TRcuSet so that another thread
+// can run its callbacks.
+struct TRcuBatch {
+    TRcuGroup* first_;
+    TRcuSet* owner_;
+    uint64_t handoff_tsc_;
+    TRcuBatch* next_;
 };
 
 class TRcuSet {
@@ -81,6 +93,14 @@ public:
             grow();
         }
         current_->add(epoch, function, argument);
+        nadded_.store(nadded_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Approximate number of callbacks added but not yet run; may be read
+    // from any thread.
+    uint64_t pending() const {
+        int64_t n = nadded_.load(std::memory_order_relaxed) - nrun_.load(std::memory_order_relaxed);
+        return n > 0 ? n : 0;
     }
 
     void clean_until(epoch_type max_epoch) {
@@ -93,15 +113,87 @@ public:
         return clean_epoch_;
     }
 
+    // Instead of cleaning, detach all pending callbacks into a batch for a
+    // TRcuReclaimer. Like clean_until, does nothing unless max_epoch changed.
+    // Returns nullptr if there is nothing to hand off.
+    TRcuBatch* hand_off(epoch_type max_epoch) {
+        if (clean_epoch_ == max_epoch)
+            return nullptr;
+        clean_epoch_ = max_epoch;
+        if (first_->empty())
+            return nullptr;
+        return hard_hand_off();
+    }
+    // Return an emptied group to this set; may be called from any thread.
+    void recycle(TRcuGroup* g) {
+        TRcuGroup* head = free_.load(std::memory_order_relaxed);
+        do {
+            g->next_ = head;
+        } while (!free_.compare_exchange_weak(head, g, std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
 private:
     TRcuGroup* current_;
     TRcuGroup* first_;
     epoch_type clean_epoch_;
+    std::atomic<TRcuGroup*> free_;   // groups recycled by reclaimers
+    std::atomic<uint64_t> nadded_;   // written only by the owner
+    std::atomic<uint64_t> nrun_;     // owner or reclaimer
     // unsigned ngroups_;
 
     TRcuSet(const TRcuSet&) = delete;
     TRcuSet& operator=(const TRcuSet&) = delete;
+    void account_run(uint64_t n) {
+        if (n)
+            nrun_.fetch_add(n, std::memory_order_relaxed);
+    }
+    friend class TRcuReclaimer;
     void check();
     void grow();
     void hard_clean_until(epoch_type max_epoch);
+    TRcuBatch* hard_hand_off();
+    TRcuGroup* new_group();
+};
+
+// Runs callbacks from batches handed off by TRcuSet::hand_off. Any thread
+// may enqueue; only one thread at a time may call reclaim_until.
+class TRcuReclaimer {
+public:
+    typedef TRcuGroup::epoch_type epoch_type;
+
+    struct stats_type {
+        unsigned backlog;       // batches still pending after the pass
+        unsigned reclaimed;     // batches fully reclaimed during the pass
+        uint64_t latency_tsc;   // sum of handoff-to-reclaim ticks
+        uint64_t max_latency_tsc;
+    };
+
+    TRcuReclaimer()
+        : inbox_(nullptr), pending_(nullptr), pending_tail_(nullptr) {
+    }
+    ~TRcuReclaimer() {
+        assert(empty());
+    }
+
+    void enqueue(TRcuBatch* b) {
+        TRcuBatch* head = inbox_.load(std::memory_order_relaxed);
+        do {
+            b->next_ = head;
+        } while (!inbox_.compare_exchange_weak(head, b, std::memory_order_release,
+                                               std::memory_order_relaxed));
+    }
+    bool empty() const {
+        return !pending_ && !inbox_.load(std::memory_order_acquire);
+    }
+
+    stats_type reclaim_until(epoch_type max_epoch);
+
+private:
+    std::atomic<TRcuBatch*> inbox_;
+    TRcuBatch* pending_;
+    TRcuBatch* pending_tail_;
+
+    TRcuReclaimer(const TRcuReclaimer&) = delete;
+    TRcuReclaimer& operator=(const TRcuReclaimer&) = delete;
 };
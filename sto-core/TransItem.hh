@@ -8,6 +8,13 @@
 #include "TThread.hh"
 #include "TicTocStructs.hh"
 
+// Track read/predicate and write items in compact per-transaction index
+// arrays as their flags are raised, so the commit protocol only visits the
+// items each phase needs instead of scanning the whole tset
+#ifndef STO_TSET_INDEX
+#define STO_TSET_INDEX 1
+#endif
+
 class TWrappedAccess;
 
 class MvAccess;
@@ -50,9 +57,13 @@ class TransItem {
     static constexpr flags_type special_mask = owner_mask | cl_bit | read_bit | write_bit | lock_bit | predicate_bit | stash_bit | commute_bit | mvhistory_bit;
 
 
-    TransItem() : s_(), key_(), rdata_(), wdata_(), mode_(CCMode::none) {};
+    // membership bits for the transaction's read and write indexes
+    static constexpr uint8_t in_read_index = 1;
+    static constexpr uint8_t in_write_index = 2;
+
+    TransItem() : s_(), key_(), rdata_(), wdata_(), mode_(CCMode::none), index_() {};
     TransItem(TObject* owner, void* k)
-        : s_(reinterpret_cast<ownerstore_type>(owner)), key_(k), rdata_(), wdata_(), mode_(CCMode::none) {
+        : s_(reinterpret_cast<ownerstore_type>(owner)), key_(k), rdata_(), wdata_(), mode_(CCMode::none), index_() {
     }
 
     TObject* owner() const {
@@ -278,13 +289,24 @@ private:
     uintptr_t ts_origin_; // only used by TicToc
 
     CCMode mode_;
+    uint8_t index_;
 
     void __rm_flags(flags_type flags) {
         s_ = s_ & ~flags;
     }
     void __or_flags(flags_type flags) {
+#if STO_TSET_INDEX
+        flags_type raised = flags & ~s_ & (read_bit | write_bit | predicate_bit);
         s_ = s_ | flags;
+        if (raised)
+            __index_flags(raised);
+#else
+        s_ = s_ | flags;
+#endif
     }
+    // defined in Transaction.hh; records this item in the current
+    // transaction's read and/or write index
+    inline void __index_flags(flags_type raised);
 
     friend class Transaction;
     friend class TransProxy;
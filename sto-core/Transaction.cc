@@ -5,10 +5,18 @@
 
 #include <sys/resource.h>
 #include <sys/time.h>
+#include <pthread.h>
+#if STO_TSET_SIMD
+#include <immintrin.h>
+#endif
 
 #include "MVCC.hh"
+#include "PlatformFeatures.hh"
 
 Transaction::testing_type Transaction::testing;
+const char* const latency_histogram_names[lh_count] = {
+    "execution", "commit_lock", "commit_check", "commit_install", "end_to_end"
+};
 threadinfo_t Transaction::tinfo[MAX_THREADS];
 __thread int TThread::the_id;
 PercentGen TThread::gen[MAX_THREADS];
@@ -24,6 +32,21 @@ std::atomic<TransactionTid::type> __attribute__((aligned(128)))
     Transaction::_RTID(2 * TransactionTid::increment_value);
    // reserve TransactionTid::increment_value for prepopulated
 unsigned Transaction::us_per_epoch = 1000;  // Defaults to 1ms
+unsigned Transaction::validate_every_ = 0;
+bool Transaction::validate_checkpoints_ = false;
+TransactionTid::type Transaction::mvcc_read_lease_ = 0;
+#if STO_TID_LEASE
+std::atomic<TransactionTid::type> Transaction::tid_floor_[Transaction::tid_floor_ring];
+#endif
+std::atomic<uint64_t> Transaction::live_threads_[(MAX_THREADS + 63) / 64];
+bool Transaction::rcu_offload_ = false;
+std::vector<std::unique_ptr<TRcuReclaimer>> Transaction::rcu_reclaimers_;
+std::vector<std::thread> Transaction::rcu_helpers_;
+std::unique_ptr<EpochController> Transaction::epoch_controller_;
+Transaction::epoch_control_stats Transaction::epoch_control_stats_;
+#if STO_TSET_SIMD
+int Transaction::tset_simd_ = Transaction::detect_tset_simd();
+#endif
 
 static void __attribute__((used)) check_static_assertions() {
     static_assert(sizeof(threadinfo_t) % 128 == 0, "threadinfo is 2-cache-line aligned");
@@ -33,16 +56,29 @@ void Transaction::initialize() {
     static_assert(tset_initial_capacity % tset_chunk == 0, "tset_initial_capacity not an even multiple of tset_chunk");
     hash_base_ = 32768;
     tset_size_ = 0;
+    reads_since_validate_ = 0;
     lrng_state_ = 12897;
 #if CICADA_HASHTABLE == 0 && defined(TRANSACTION_HASHTABLE)
     bzero(hashtable_, sizeof(hashtable_));
+#endif
+#if TRANSACTION_FILTER
+    bzero(filter_, sizeof(filter_));
 #endif
     commit_tid_ = 0;
     prev_commit_tid_ = 0;
+#if STO_TSC_PROFILE
+    first_start_tsc_ = 0;
+#endif
     for (unsigned i = 0; i != tset_initial_capacity / tset_chunk; ++i)
         tset_[i] = &tset0_[i * tset_chunk];
     for (unsigned i = tset_initial_capacity / tset_chunk; i != arraysize(tset_); ++i)
         tset_[i] = nullptr;
+#if STO_TSET_SIMD
+    for (unsigned i = 0; i != tset_initial_capacity / tset_chunk; ++i)
+        shadow_[i] = &shadow0_[i];
+    for (unsigned i = tset_initial_capacity / tset_chunk; i != arraysize(shadow_); ++i)
+        shadow_[i] = nullptr;
+#endif
 }
 
 Transaction::~Transaction() {
@@ -52,6 +88,10 @@ Transaction::~Transaction() {
     for (unsigned i = 0; i != arraysize(tset_); ++i, live += tset_chunk)
         if (live != tset_[i])
             delete[] tset_[i];
+#if STO_TSET_SIMD
+    for (unsigned i = tset_initial_capacity / tset_chunk; i != arraysize(shadow_); ++i)
+        delete shadow_[i];
+#endif
 }
 
 void Transaction::refresh_tset_chunk() {
@@ -59,9 +99,80 @@ void Transaction::refresh_tset_chunk() {
     assert(tset_size_ < tset_max_capacity);
     if (!tset_[tset_size_ / tset_chunk])
         tset_[tset_size_ / tset_chunk] = new TransItem[tset_chunk];
+#if STO_TSET_SIMD
+    if (!shadow_[tset_size_ / tset_chunk])
+        shadow_[tset_size_ / tset_chunk] = new TsetShadow;
+#endif
     tset_next_ = tset_[tset_size_ / tset_chunk];
 }
 
+#if STO_TSET_SIMD
+int Transaction::detect_tset_simd() {
+    if (cpu_has_feature<Avx512fQuery>() && os_has_vector_state(true))
+        return simd_avx512;
+    else if (cpu_has_feature<Avx2Query>() && os_has_vector_state(false))
+        return simd_avx2;
+    else
+        return simd_none;
+}
+
+// Each helper returns the index of the first i in [0, n) with
+// owner[i] == o && key[i] == k, or n if there is none.
+__attribute__((target("avx2")))
+static unsigned tset_shadow_find_avx2(const uintptr_t* owner, const uintptr_t* key,
+                                      unsigned n, uintptr_t o, uintptr_t k) {
+    __m256i vo = _mm256_set1_epi64x(o), vk = _mm256_set1_epi64x(k);
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i eo = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*) &owner[i]), vo);
+        __m256i ek = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*) &key[i]), vk);
+        int m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_and_si256(eo, ek)));
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    for (; i != n; ++i)
+        if (owner[i] == o && key[i] == k)
+            break;
+    return i;
+}
+
+__attribute__((target("avx512f")))
+static unsigned tset_shadow_find_avx512(const uintptr_t* owner, const uintptr_t* key,
+                                        unsigned n, uintptr_t o, uintptr_t k) {
+    __m512i vo = _mm512_set1_epi64(o), vk = _mm512_set1_epi64(k);
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __mmask8 m = _mm512_mask_cmpeq_epi64_mask(
+            _mm512_cmpeq_epi64_mask(_mm512_loadu_si512(&owner[i]), vo),
+            _mm512_loadu_si512(&key[i]), vk);
+        if (m)
+            return i + __builtin_ctz(m);
+    }
+    for (; i != n; ++i)
+        if (owner[i] == o && key[i] == k)
+            break;
+    return i;
+}
+
+TransItem* Transaction::find_item_simd(TObject* obj, void* xkey) const {
+    uintptr_t o = reinterpret_cast<uintptr_t>(obj);
+    uintptr_t k = reinterpret_cast<uintptr_t>(xkey);
+    for (unsigned base = 0; base < tset_size_; base += tset_chunk) {
+        unsigned n = std::min(tset_size_ - base, unsigned(tset_chunk));
+        const TsetShadow* sh = shadow_[base / tset_chunk];
+        unsigned i;
+        if (tset_simd_ == simd_avx512)
+            i = tset_shadow_find_avx512(sh->owner, sh->key, n, o, k);
+        else
+            i = tset_shadow_find_avx2(sh->owner, sh->key, n, o, k);
+        TXP_ACCOUNT(txp_total_searched, i == n ? n : i + 1);
+        if (i != n)
+            return &tset_[base / tset_chunk][i];
+    }
+    return nullptr;
+}
+#endif
+
 void* Transaction::epoch_advancer(void*) {
     static int num_epoch_advancers = 0;
     if (fetch_and_add(&num_epoch_advancers, 1) != 0)
@@ -71,6 +182,8 @@ void* Transaction::epoch_advancer(void*) {
     usleep(us_per_epoch);
     while (global_epochs.run) {
         global_epoch_advance_once();
+        if (epoch_controller_)
+            adapt_epoch_cycle();
         usleep(us_per_epoch);
     }
 
@@ -82,8 +195,7 @@ void Transaction::global_epoch_advance_once() {
     epoch_type ge = global_epochs.global_epoch.load();
     epoch_type re = global_epochs.global_epoch.load();
     epoch_type ae = global_epochs.read_epoch.load();
-    int i = 0;
-    for (auto& t : tinfo) {
+    for_each_live_thread([&] (threadinfo_t& t) {
         auto twepoch = t.write_snapshot_epoch.load();
         auto trepoch = t.epoch.load();
         if (twepoch != 0 && signed_epoch_type(twepoch - re) < 0) {
@@ -92,8 +204,11 @@ void Transaction::global_epoch_advance_once() {
         if (trepoch != 0 && signed_epoch_type(trepoch - ae) < 0) {
             ae = trepoch;
         }
-        i++;
-    }
+    });
+#if STO_TID_LEASE
+    // publish the floor before any thread can take a lease in the new epoch
+    tid_floor_[std::max(ge + 1, epoch_type(1)) % tid_floor_ring] = _TID.load();
+#endif
     global_epochs.global_epoch = std::max(ge + 1, epoch_type(1));
     global_epochs.read_epoch = re;
     global_epochs.active_epoch = ae;
@@ -105,12 +220,22 @@ void Transaction::global_epoch_advance_once() {
 
 void Transaction::epoch_advance_once() {
     tid_type min_wtid = _TID.load(std::memory_order_relaxed);
-    for (auto& t : tinfo) {
+#if STO_TID_LEASE
+    // an idle thread's lease is unusable once opacity_start_tid() passes it;
+    // start() rechecks the epoch after publishing its lease to match
+    tid_type lease_floor = opacity_start_tid();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+    for_each_live_thread([&] (threadinfo_t& t) {
         fence();
         tid_type wtid = t.wtid;
+#if STO_TID_LEASE
+        if (wtid & idle_lease_bit)
+            wtid = std::max(wtid & ~idle_lease_bit, lease_floor);
+#endif
         if (wtid != 0 && wtid < min_wtid)
             min_wtid = wtid;
-    }
+    });
     fence();
     if (min_wtid > 0) {
         tid_type next = min_wtid - TransactionTid::increment_value;
@@ -121,6 +246,115 @@ void Transaction::epoch_advance_once() {
     }
 }
 
+void Transaction::set_adaptive_epoch_cycle(const EpochController::params_type& params) {
+    epoch_controller_.reset(new EpochController(params, us_per_epoch));
+    epoch_control_stats_ = {0, 0, UINT_MAX, 0, 0, _TID.load(std::memory_order_relaxed), 0, 0};
+    set_epoch_cycle(epoch_controller_->period());
+}
+
+void Transaction::adapt_epoch_cycle() {
+    EpochController::sample_type sample = {0, 0.0, 0};
+    uint64_t flat_runs = 0, flat_versions = 0;
+    for_each_live_thread([&] (threadinfo_t& t) {
+        sample.backlog += t.rcu_set.pending();
+        flat_runs += t.p_.p(txp_mvcc_flat_runs);
+        flat_versions += t.p_.p(txp_mvcc_flat_versions);
+    });
+    auto& st = epoch_control_stats_;
+    // flatten counters are cumulative; use the mean over the last interval
+    if (flat_runs > st.last_flat_runs)
+        sample.chain = double(flat_versions - st.last_flat_versions) / (flat_runs - st.last_flat_runs);
+    st.last_flat_runs = flat_runs;
+    st.last_flat_versions = flat_versions;
+    // every writing commit advances _TID
+    auto tid = _TID.load(std::memory_order_relaxed);
+    sample.commits = (tid - st.last_tid) / TransactionTid::increment_value;
+    st.last_tid = tid;
+
+    unsigned period = epoch_controller_->update(sample);
+    if (period != us_per_epoch)
+        set_epoch_cycle(period);
+
+    ++st.samples;
+    st.period_total += period;
+    st.period_min = std::min(st.period_min, period);
+    st.period_max = std::max(st.period_max, period);
+    st.backlog_max = std::max(st.backlog_max, sample.backlog);
+}
+
+void Transaction::register_live_thread() {
+    int id = TThread::id();
+    tinfo[id].live = true;
+    live_threads_[id / 64].fetch_or(uint64_t(1) << (id % 64));
+}
+
+void Transaction::rcu_hand_off(threadinfo_t& thr) {
+    TRcuBatch* b = thr.rcu_set.hand_off(global_epochs.active_epoch.load(std::memory_order_acquire));
+    if (b) {
+        rcu_reclaimers_[TThread::id() % rcu_reclaimers_.size()]->enqueue(b);
+        TXP_INCREMENT(txp_rcu_handoffs);
+    }
+}
+
+void Transaction::start_rcu_helpers(const TopologyInfo& topo, unsigned per_node) {
+    always_assert(rcu_reclaimers_.empty(), "RCU helpers already running");
+    unsigned nnodes = std::max(topo.num_nodes, 1);
+    unsigned nhelpers = nnodes * std::max(per_node, 1u);
+    always_assert(nhelpers < MAX_THREADS, "too many RCU helpers");
+    // reclaimer k serves node k % nnodes, so thread i maps to node i % nnodes
+    for (unsigned k = 0; k != nhelpers; ++k)
+        rcu_reclaimers_.emplace_back(new TRcuReclaimer);
+    rcu_offload_ = true;
+    for (unsigned k = 0; k != nhelpers; ++k) {
+        std::vector<int> cpus;
+        if (k % nnodes < topo.cpu_id_list.size())
+            cpus = topo.cpu_id_list[k % nnodes];
+        rcu_helpers_.emplace_back(&Transaction::rcu_helper, k, std::move(cpus));
+    }
+}
+
+void Transaction::rcu_helper(unsigned index, std::vector<int> cpus) {
+#if !defined(__APPLE__)
+    if (!cpus.empty()) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for (int c : cpus)
+            CPU_SET(c, &cpuset);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    }
+#else
+    (void) cpus;
+#endif
+    TThread::set_id(MAX_THREADS - 1 - index);
+    register_live_thread();
+    threadinfo_t& thr = this_thread();
+    TRcuReclaimer& reclaimer = *rcu_reclaimers_[index];
+
+    while (global_epochs.run) {
+        rcu_reclaim_pass(thr, reclaimer);
+        usleep(us_per_epoch);
+    }
+}
+
+void Transaction::rcu_reclaim_pass(threadinfo_t& thr, TRcuReclaimer& reclaimer) {
+    // callbacks may defer more work (e.g. MVCC history deletion), which goes
+    // to this thread's own set at the current epoch
+    thr.write_snapshot_epoch.store(global_epochs.global_epoch.load(std::memory_order_acquire),
+                                   std::memory_order_release);
+    auto ae = global_epochs.active_epoch.load(std::memory_order_acquire);
+    auto stats = reclaimer.reclaim_until(ae);
+    thr.rcu_set.clean_until(ae);
+    // don't hold back read_epoch while sleeping
+    thr.write_snapshot_epoch.store(0, std::memory_order_release);
+
+    TXP_INCREMENT(txp_rcu_reclaim_passes);
+    TXP_ACCOUNT(txp_rcu_reclaim_batches, stats.reclaimed);
+    TXP_ACCOUNT(txp_rcu_backlog_total, stats.backlog);
+    TXP_ACCOUNT(txp_rcu_backlog_max, stats.backlog);
+    TXP_ACCOUNT(txp_rcu_reclaim_tsc, stats.latency_tsc);
+    TXP_ACCOUNT(txp_rcu_reclaim_tsc_max, stats.max_latency_tsc);
+}
+
 bool Transaction::preceding_duplicate_read(TransItem* needle) const {
     const TransItem* it = nullptr;
     for (unsigned tidx = 0; ; ++tidx) {
@@ -164,27 +398,57 @@ bool Transaction::hard_check_opacity(TransItem* item, TransactionTid::type t) {
         TXP_INCREMENT(txp_hco_invalid);
 
     state_ = s_opacity_check;
-    start_tid_ = _TID.load(std::memory_order_relaxed);
+    start_tid_ = opacity_start_tid();
     release_fence();
+    if (TransItem* it = stale_read_item()) {
+        mark_abort_because(item, it->has_read() ? "opacity check" : "opacity check_predicate");
+        goto abort;
+    }
+    state_ = s_in_progress;
+    return true;
+}
+
+// Returns the first read or predicate item that no longer validates, or
+// nullptr if all do.
+TransItem* Transaction::stale_read_item() {
     TransItem* it = nullptr;
+#if STO_TSET_INDEX
+    for (unsigned i = 0; i != rindex_.size(); ++i) {
+        it = rindex_[i];
+#else
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
         it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
+#endif
         if (it->has_read()) {
             TXP_INCREMENT(txp_total_check_read);
             if (!it->owner()->check(*it, *this)
-                && (!may_duplicate_items_ || !preceding_duplicate_read(it))) {
-                mark_abort_because(item, "opacity check");
-                goto abort;
-            }
+                && (!may_duplicate_items_ || !preceding_duplicate_read(it)))
+                return it;
         } else if (it->has_predicate()) {
             TXP_INCREMENT(txp_total_check_predicate);
-            if (!it->owner()->check_predicate(*it, *this, false)) {
-                mark_abort_because(item, "opacity check_predicate");
-                goto abort;
-            }
+            if (!it->owner()->check_predicate(*it, *this, false))
+                return it;
         }
     }
+    return nullptr;
+}
+
+bool Transaction::validate_reads() {
+    assert(state_ == s_in_progress);
+    reads_since_validate_ = 0;
+    TXP_INCREMENT(txp_incr_validations);
+    // checks must not recurse into another validation or opacity check
+    state_ = s_opacity_check;
+    TransItem* it = stale_read_item();
     state_ = s_in_progress;
+    if (it) {
+        mark_abort_because(it, it->has_read() ? "incremental check" : "incremental check_predicate");
+        TXP_INCREMENT(txp_incr_validation_aborts);
+#if STO_TSC_PROFILE
+        TSC_ACCOUNT(tc_validate_wasted, read_tsc() - start_tsc_);
+#endif
+        return false;
+    }
     return true;
 }
 
@@ -222,6 +486,28 @@ void Transaction::stop(bool committed, unsigned* writeset, unsigned nwriteset) {
     TXP_ACCOUNT(txp_total_transbuffer, buf_.buffer_size());
 
     TransItem* it;
+#if STO_TSET_INDEX
+    (void) writeset, (void) nwriteset;
+    if (any_writes_) {
+        for (unsigned i = windex_.size(); i != 0; ) {
+            it = windex_[--i];
+            if (it->has_write())
+                it->owner()->cleanup(*it, committed);
+        }
+    }
+
+    // every item holding a lock was indexed when its read or write flag was set
+    for (unsigned i = windex_.size(); i != 0; ) {
+        it = windex_[--i];
+        if (it->needs_unlock())
+            it->owner()->unlock(*it);
+    }
+    for (unsigned i = rindex_.size(); i != 0; ) {
+        it = rindex_[--i];
+        if (it->needs_unlock() && !(it->index_ & TransItem::in_write_index))
+            it->owner()->unlock(*it);
+    }
+#else
     if (!any_writes_)
         goto unlock_all;
 
@@ -276,12 +562,22 @@ unlock_all:
         if (it->needs_unlock())
             it->owner()->unlock(*it);
     }
+#endif
 
     // TODO: this will probably mess up with nested transactions
     threadinfo_t& thr = tinfo[TThread::id()];
     if (thr.trans_end_callback)
         thr.trans_end_callback();
+#if STO_TID_LEASE
+    // this thread's next commit TID may still come from its lease, so keep
+    // epoch_advance_once from moving _RTID past it until the lease is stale
+    if (lease_usable(thr, global_epochs.global_epoch.load(std::memory_order_acquire)))
+        thr.wtid.store(thr.lease_next | idle_lease_bit, std::memory_order_release);
+    else
+        thr.wtid.store(0, std::memory_order_release);
+#else
     thr.wtid.store(0, std::memory_order_release);
+#endif
     // XXX should reset trans_end_callback after calling it...
     state_ = s_aborted + committed;
     restarted = true;
@@ -299,6 +595,10 @@ unlock_all:
     auto endtime = read_tsc();
     if (!committed)
         TSC_ACCOUNT(tc_abort, endtime - start_tsc_);
+    else {
+        thr.lh_[lh_end_to_end].record(endtime - first_start_tsc_);
+        first_start_tsc_ = 0;
+    }
 #endif
 
     //COZ_PROGRESS;
@@ -320,6 +620,10 @@ bool Transaction::try_commit() {
     TXP_ACCOUNT(txp_total_n, tset_size_);
 
     assert(state_ == s_in_progress || state_ >= s_aborted);
+#if STO_TSC_PROFILE
+    if (state_ == s_in_progress)
+        this_thread().lh_[lh_execution].record(tk.init_tsc_val() - start_tsc_);
+#endif
     if (state_ >= s_aborted) {
         return state_ > s_aborted;
     }
@@ -336,11 +640,106 @@ bool Transaction::try_commit() {
 
     state_ = s_committing;
 
+#if STO_TSET_INDEX
+    TransItem* it;
+
+    //phase1
+    {
+#if STO_TSC_PROFILE
+        TimeKeeper<tc_commit_lock> tk_lock;
+#endif
+        for (unsigned i = 0; i != windex_.size(); ++i) {
+            it = windex_[i];
+            if (!it->has_write())
+                continue;
+            state_ = s_committing_locked;
+            if (!it->needs_unlock() && !it->owner()->lock(*it, *this)) {
+                mark_abort_because(it, "commit lock");
+                goto abort;
+            }
+            it->__or_flags(TransItem::lock_bit);
+            it->__or_flags(TransItem::cl_bit);
+        }
+
+        // check_predicate may register new reads; index-based iteration
+        // picks those up as well
+        for (unsigned i = 0; i != rindex_.size(); ++i) {
+            it = rindex_[i];
+            if (it->has_read()) {
+                TXP_INCREMENT(txp_total_r);
+                if (it->cc_mode() == CCMode::opt) {
+                    TXP_INCREMENT(txp_total_adaptive_opt);
+                }
+                // tracking TicToc commit ts (for reads) here
+                if (it->cc_mode() == CCMode::tictoc) {
+                    if (it->is_tictoc_compressed())
+                        it->tictoc_extract_read_ts<TicTocCompressedVersion<>>().compute_commit_ts_step(this->tictoc_tid_, false/* !write */);
+                    else
+                        it->tictoc_extract_read_ts<TicTocVersion<>>().compute_commit_ts_step(this->tictoc_tid_, false /* ! write */);
+                }
+            } else if (it->has_predicate()) {
+                TXP_INCREMENT(txp_total_check_predicate);
+                if (!it->owner()->check_predicate(*it, *this, true)) {
+                    mark_abort_because(it, "commit check_predicate");
+                    goto abort;
+                }
+            }
+        }
+    }
+
+#if CONSISTENCY_CHECK
+    fence();
+    commit_tid();
+    fence();
+#endif
+
+    //phase2
+    {
+#if STO_TSC_PROFILE
+        TimeKeeper<tc_commit_check> tk_check;
+#endif
+        for (unsigned i = 0; i != rindex_.size(); ++i) {
+            it = rindex_[i];
+            if (it->has_read() && (it->locked_at_commit() || !it->needs_unlock())) {
+                TXP_INCREMENT(txp_total_check_read);
+                if (!it->owner()->check(*it, *this)
+                    && (!may_duplicate_items_ || !preceding_duplicate_read(it))) {
+                    mark_abort_because(it, "commit check");
+                    goto abort;
+                }
+            }
+        }
+    }
+
+    //phase3
+#if STO_TID_LEASE
+    installing_ = true;
+#endif
+    {
+#if STO_TSC_PROFILE
+        TimeKeeper<tc_commit_install> tk_install;
+#endif
+        for (unsigned i = 0; i != windex_.size(); ++i) {
+            it = windex_[i];
+            if (it->has_write()) {
+                TXP_INCREMENT(txp_total_w);
+                it->owner()->install(*it, *this);
+            }
+        }
+    }
+
+    stop(true, nullptr, 0);
+    return true;
+#else
     unsigned writeset[tset_size_];
     unsigned nwriteset = 0;
     writeset[0] = tset_size_;
 
     TransItem* it = nullptr;
+    {
+#if STO_TSC_PROFILE
+    TimeKeeper<tc_commit_lock> tk_lock;
+#endif
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
         it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
         if (it->has_write()) {
@@ -403,6 +802,7 @@ bool Transaction::try_commit() {
         }
     }
 #endif
+    }
 
 #if CONSISTENCY_CHECK
     fence();
@@ -411,6 +811,10 @@ bool Transaction::try_commit() {
 #endif
 
     //phase2
+    {
+#if STO_TSC_PROFILE
+    TimeKeeper<tc_commit_check> tk_check;
+#endif
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
         it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
         if (it->has_read() && (it->locked_at_commit() || !it->needs_unlock())) {
@@ -422,10 +826,18 @@ bool Transaction::try_commit() {
             }
         }
     }
+    }
 
     // fence();
 
     //phase3
+#if STO_TID_LEASE
+    installing_ = true;
+#endif
+    {
+#if STO_TSC_PROFILE
+    TimeKeeper<tc_commit_install> tk_install;
+#endif
 #if STO_SORT_WRITESET
     for (unsigned tidx = first_write_; tidx != tset_size_; ++tidx) {
         it = &tset_[tidx / tset_chunk][tidx % tset_chunk];
@@ -447,12 +859,14 @@ bool Transaction::try_commit() {
         }
     }
 #endif
+    }
 
     // fence();
     stop(true, writeset, nwriteset);
 
     //COZ_PROGRESS;
     return true;
+#endif
 
 abort:
     //outfile.close();
@@ -537,6 +951,17 @@ void Transaction::print_stats() {
         fprintf(stderr, "$ %llu (%.3f%%) hash collisions, %llu second level\n", out.p(txp_hash_collision),
                 100.0 * (double) out.p(txp_hash_collision) / out.p(txp_hash_find),
                 out.p(txp_hash_collision2));
+    if (txp_count > txp_bv_false_positive && out.p(txp_bv_hit) + out.p(txp_bv_false_positive))
+        fprintf(stderr, "$ %llu lookups skipped by tset filter, %llu filter false positives (%.3f%%)\n",
+                out.p(txp_bv_hit), out.p(txp_bv_false_positive),
+                100.0 * out.p(txp_bv_false_positive) / (out.p(txp_bv_hit) + out.p(txp_bv_false_positive)));
+    if (txp_count > txp_incr_validation_aborts && out.p(txp_incr_validations))
+        fprintf(stderr, "$ %llu incremental validations, %llu early aborts\n",
+                out.p(txp_incr_validations), out.p(txp_incr_validation_aborts));
+    if (txp_count > txp_mvcc_rtid_writes && out.p(txp_mvcc_rtid_checks))
+        fprintf(stderr, "$ %llu MVCC read checks, %llu rtid writes (%.3f%%)\n",
+                out.p(txp_mvcc_rtid_checks), out.p(txp_mvcc_rtid_writes),
+                100.0 * out.p(txp_mvcc_rtid_writes) / out.p(txp_mvcc_rtid_checks));
     if (txp_count >= txp_total_transbuffer)
         fprintf(stderr, "$ %llu max buffer per txn, %llu total buffer\n",
                 out.p(txp_max_transbuffer), out.p(txp_total_transbuffer));
@@ -549,6 +974,19 @@ void Transaction::print_stats() {
         fprintf(stderr, "$        Spinning runs: %llu\n", out.p(txp_mvcc_flat_spins));
         fprintf(stderr, "$     Avg spins/commit: %.3f\n", 1.0 * out.p(txp_mvcc_flat_spins) / out.p(txp_mvcc_flat_commits));
     }
+    if (txp_count >= txp_rcu_reclaim_tsc_max && out.p(txp_rcu_reclaim_passes)) {
+        double ms_per_tick = 1.0 / (PROC_TSC_FREQ * 1000000.0);
+        fprintf(stderr, "$ RCU reclamation helpers:\n");
+        fprintf(stderr, "$             Handoffs: %llu\n", out.p(txp_rcu_handoffs));
+        fprintf(stderr, "$    Reclaimed batches: %llu\n", out.p(txp_rcu_reclaim_batches));
+        fprintf(stderr, "$     Avg backlog/pass: %.3f batches\n",
+                1.0 * out.p(txp_rcu_backlog_total) / out.p(txp_rcu_reclaim_passes));
+        fprintf(stderr, "$          Max backlog: %llu batches\n", out.p(txp_rcu_backlog_max));
+        fprintf(stderr, "$  Avg reclaim latency: %.3f ms\n",
+                ms_per_tick * out.p(txp_rcu_reclaim_tsc) / out.p(txp_rcu_reclaim_batches));
+        fprintf(stderr, "$  Max reclaim latency: %.3f ms\n",
+                ms_per_tick * out.p(txp_rcu_reclaim_tsc_max));
+    }
     if (txp_count >= txp_tpcc_st_aborts) {
         fprintf(stderr, "$ TPCC txn profiles: commits(aborts), abort rate\n");
         fprintf(stderr, "$     New-Order: %llu(%llu), %.3f%%\n", out.p(txp_tpcc_no_commits), out.p(txp_tpcc_no_aborts),
@@ -584,6 +1022,13 @@ void Transaction::print_stats() {
         fprintf(stderr, "$      Check Abort 2: %llu\n", out.p(txp_tpcc_check_abort2));
     }
 
+    if (epoch_controller_ && epoch_control_stats_.samples) {
+        auto& st = epoch_control_stats_;
+        fprintf(stderr, "$ Adaptive epochs: %llu samples, period avg %.1f us (min %u, max %u, now %u), max RCU backlog %llu\n",
+                (unsigned long long) st.samples, 1.0 * st.period_total / st.samples,
+                st.period_min, st.period_max, us_per_epoch, (unsigned long long) st.backlog_max);
+    }
+
 #if STO_TSC_PROFILE
     tc_counters out_tcs = tc_counters_combined();
     std::stringstream ss;
@@ -591,17 +1036,50 @@ void Transaction::print_stats() {
     ss << "   time_commit: " << out_tcs.to_realtime(tc_commit) << std::endl;
     ss << "   time_commit_wasted: " << out_tcs.to_realtime(tc_commit_wasted) << std::endl;
     ss << "   time_find_item: " << out_tcs.to_realtime(tc_find_item) << std::endl;
+    ss << "   time_commit_lock: " << out_tcs.to_realtime(tc_commit_lock) << std::endl;
+    ss << "   time_commit_check: " << out_tcs.to_realtime(tc_commit_check) << std::endl;
+    ss << "   time_commit_install: " << out_tcs.to_realtime(tc_commit_install) << std::endl;
     ss << "   time_abort: " << out_tcs.to_realtime(tc_abort) << std::endl;
     ss << "   time_cleanup: " << out_tcs.to_realtime(tc_cleanup) << std::endl;
     ss << "   time_opacity: " << out_tcs.to_realtime(tc_opacity) << std::endl;
     ss << "   time_elapsed: " << out_tcs.to_realtime(tc_elapsed) << std::endl;
+    ss << "   time_tid_alloc: " << out_tcs.to_realtime(tc_tid_alloc) << std::endl;
+    ss << "   time_validate_wasted: " << out_tcs.to_realtime(tc_validate_wasted) << std::endl;
 
     fprintf(stderr, "%s\n", ss.str().c_str());
 #endif
 
+    MvRegistry::print_stats(std::cerr);
     fprintf(stderr, "$ %llu next commit-tid\n", (unsigned long long) _TID.load(std::memory_order_relaxed));
 }
 
+void Transaction::print_latency_json(std::ostream& os, double tsc_ghz) {
+#if STO_TSC_PROFILE
+    os << "{\"unit\":\"tsc\",\"tsc_ghz\":" << tsc_ghz << ",\"combined\":{";
+    for (int lh = 0; lh != lh_count; ++lh) {
+        os << (lh ? "," : "") << "\"" << latency_histogram_names[lh] << "\":";
+        latency_histogram_combined(lh).print_json(os, true);
+    }
+    os << "},\"threads\":[";
+    const char* sep = "";
+    for (int i = 0; i != MAX_THREADS; ++i) {
+        if (!tinfo[i].lh_[lh_end_to_end].count())
+            continue;
+        os << sep << "{\"thread\":" << i;
+        for (int lh = 0; lh != lh_count; ++lh) {
+            os << ",\"" << latency_histogram_names[lh] << "\":";
+            tinfo[i].lh_[lh].print_json(os, false);
+        }
+        os << "}";
+        sep = ",";
+    }
+    os << "]}";
+#else
+    (void) tsc_ghz;
+    os << "{}";
+#endif
+}
+
 const char* Transaction::state_name(int state) {
     static const char* names[] = {"in-progress", "opacity-check", "committing", "committing-locked", "aborted", "committed"};
     if (unsigned(state) < arraysize(names))
@@ -657,24 +1135,48 @@ void Transaction::rcu_release_all(std::thread& epoch_advancer, int num_work_thre
     if (epoch_advancer.joinable()) {
         epoch_advancer.join();
     }
+    for (auto& helper : rcu_helpers_) {
+        helper.join();
+    }
+    rcu_helpers_.clear();
+    // their leftover entries go to this thread's RCU set, drained below
+    MvFlattenPool::stop();
+    MvRegistry::stop();
+
+    // work threads plus any other registered thread (e.g. RCU helpers)
+    auto for_each_thread = [&] (std::function<void(threadinfo_t&)> f) {
+        for (int i = 0; i < num_work_threads; ++i)
+            f(tinfo[i]);
+        for_each_live_thread([&] (threadinfo_t& t) {
+            if (&t - tinfo >= num_work_threads)
+                f(t);
+        });
+    };
 
     auto wse = global_epochs.global_epoch.load(std::memory_order_relaxed);
-    for (int i = 0; i < num_work_threads; ++i) {
-        wse = std::max(wse, Transaction::tinfo[i].write_snapshot_epoch.load(std::memory_order_relaxed));
-    }
+    for_each_thread([&] (threadinfo_t& t) {
+        wse = std::max(wse, t.write_snapshot_epoch.load(std::memory_order_relaxed));
+    });
     assert(wse > global_epochs.active_epoch.load());
 
     bool more = true;
     while (more) {
         more = false;
         auto ae = global_epochs.active_epoch.load();
-        // XXX this would be safe to do in parallel too
-        for (int i = 0; i < num_work_threads; ++i) {
-            Transaction::tinfo[i].write_snapshot_epoch = wse;
-            Transaction::tinfo[i].rcu_set.clean_until(ae);
-            more = more || !Transaction::tinfo[i].rcu_set.empty();
+        // helpers have stopped, so this thread drains their pending batches
+        for (auto& reclaimer : rcu_reclaimers_) {
+            reclaimer->reclaim_until(ae);
+            more = more || !reclaimer->empty();
         }
+        // XXX this would be safe to do in parallel too
+        for_each_thread([&] (threadinfo_t& t) {
+            t.write_snapshot_epoch = wse;
+            t.rcu_set.clean_until(ae);
+            more = more || !t.rcu_set.empty();
+        });
         global_epochs.active_epoch.store(ae + 1);
         ++wse;
     }
+    rcu_offload_ = false;
+    rcu_reclaimers_.clear();
 }
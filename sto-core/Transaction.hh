@@ -4,6 +4,8 @@
 #include "compiler.hh"
 #include "small_vector.hh"
 #include "TRcu.hh"
+#include "EpochController.hh"
+#include "LatencyHistogram.hh"
 #include "ContentionManager.hh"
 #include "TransScratch.hh"
 #include "VersionBase.hh"
@@ -17,6 +19,7 @@
 #include <fstream>
 #include <atomic>
 #include <thread>
+#include <vector>
 
 //#include <coz.h>
 
@@ -55,6 +58,23 @@
 #define STO_SORT_WRITESET 0
 #endif
 
+#if STO_SORT_WRITESET && STO_TSET_INDEX
+#error "STO_SORT_WRITESET requires STO_TSET_INDEX=0"
+#endif
+
+// Keep a structure-of-arrays copy of each tset chunk's (owner, key) pairs so
+// find_item_scan can compare several items per instruction with AVX2 or
+// AVX-512 when the CPU supports them
+#ifndef STO_TSET_SIMD
+#define STO_TSET_SIMD 0
+#endif
+
+// Commit TIDs are handed out in per-thread leases of this many TIDs
+// instead of one fetch-add on the global _TID per commit. 0 disables leases.
+#ifndef STO_TID_LEASE
+#define STO_TID_LEASE 0
+#endif
+
 #ifndef DEBUG_SKEW
 #define DEBUG_SKEW 0
 #endif
@@ -100,7 +120,11 @@
 #define CONSISTENCY_CHECK 0
 #define ASSERT_TX_SIZE 0
 #define TRANSACTION_HASHTABLE 1
-//#define TRANSACTION_FILTER 0
+// Per-transaction Bloom filter over tset (owner, key) pairs; lookups of keys
+// the filter rules out skip the hashtable probe and collision scan
+#ifndef TRANSACTION_FILTER
+#define TRANSACTION_FILTER 1
+#endif
 
 #if ASSERT_TX_SIZE
 #if STO_PROFILE_COUNTERS > 1
@@ -133,6 +157,19 @@
             __txn_guard.start();                  \
             Sto::mvcc_rw_upgrade();
 
+// Read-only snapshot transaction: under MVCC, index reads go straight to the
+// version visible at read_tid without creating TransItems. The body must
+// not write.
+#define ROTRANSACTION                             \
+    do {                                          \
+        __label__ abort_in_progress;              \
+        __label__ try_commit;                     \
+        __label__ after_commit;                   \
+        TransactionLoopGuard __txn_guard;         \
+        while (1) {                               \
+            __txn_guard.start();                  \
+            Sto::mvcc_ro_snapshot();
+
 #define RETRY(retry)                              \
             goto try_commit;                      \
 abort_in_progress:                                \
@@ -168,6 +205,14 @@ if (!(trans_op))             \
             Sto::mvcc_rw_upgrade();               \
             try {
 
+#define ROTRANSACTION_E                           \
+    do {                                          \
+        TransactionLoopGuard __txn_guard;         \
+        while (1) {                               \
+            __txn_guard.start();                  \
+            Sto::mvcc_ro_snapshot();              \
+            try {
+
 #define RETRY_E(retry)                            \
                 if (__txn_guard.try_commit())     \
                     break;                        \
@@ -189,6 +234,7 @@ if (!(trans_op)) {throw Transaction::Abort();}
 
 #define TXN   TRANSACTION_E
 #define RWTXN RWTRANSACTION_E
+#define RO_TXN ROTRANSACTION_E
 #define CHK   TXN_DO_E
 #define TEND  RETRY_E
 
@@ -196,6 +242,7 @@ if (!(trans_op)) {throw Transaction::Abort();}
 
 #define TXN   TRANSACTION
 #define RWTXN RWTRANSACTION
+#define RO_TXN ROTRANSACTION
 #define CHK   TXN_DO
 #define TEND  RETRY
 
@@ -293,6 +340,19 @@ enum txp {
     txp_total_sum,
     txp_gc_inserts,
     txp_gc_deletes,
+    txp_rcu_handoffs,
+    txp_rcu_reclaim_passes,
+    txp_rcu_reclaim_batches,
+    txp_rcu_backlog_total,
+    txp_rcu_backlog_max,
+    txp_rcu_reclaim_tsc,
+    txp_rcu_reclaim_tsc_max,
+    txp_tid_lease_refills,
+    txp_bv_false_positive,
+    txp_incr_validations,
+    txp_incr_validation_aborts,
+    txp_mvcc_rtid_checks,
+    txp_mvcc_rtid_writes,
 #if !STO_PROFILE_COUNTERS
     txp_count = 0
 #elif STO_PROFILE_COUNTERS == 1
@@ -304,7 +364,8 @@ enum txp {
 typedef uint64_t txp_counter_type;
 
 inline constexpr bool txp_is_max(unsigned p) {
-    return p == txp_max_set || p == txp_max_transbuffer;
+    return p == txp_max_set || p == txp_max_transbuffer
+        || p == txp_rcu_backlog_max || p == txp_rcu_reclaim_tsc_max;
 }
 
 template <unsigned P, unsigned N, bool Less = (P < N)> struct txp_helper;
@@ -347,15 +408,39 @@ enum TimingCounters {
     tc_commit = 0,
     tc_commit_wasted,
     tc_find_item,
+    tc_commit_lock,
+    tc_commit_check,
+    tc_commit_install,
     tc_abort,
     tc_cleanup,
     tc_opacity,
     tc_elapsed,
+    tc_tid_alloc,
+    tc_validate_wasted,  // start() to a failed incremental validation
     tc_count
 };
 
 typedef uint64_t tc_counter_type;
 
+// Per-thread latency distributions, recorded with STO_TSC_PROFILE
+enum LatencyHistograms {
+    lh_execution = 0,   // start() to try_commit()
+    lh_commit_lock,
+    lh_commit_check,
+    lh_commit_install,
+    lh_end_to_end,      // first start() to commit, retries included
+    lh_count
+};
+
+extern const char* const latency_histogram_names[lh_count];
+
+inline constexpr int tc_latency_histogram(int tc) {
+    return tc == tc_commit_lock ? lh_commit_lock
+        : tc == tc_commit_check ? lh_commit_check
+        : tc == tc_commit_install ? lh_commit_install
+        : -1;
+}
+
 template <int C, int N, bool Less = (C < N)>
 struct tc_helper;
 
@@ -393,6 +478,8 @@ struct tc_counters {
 #include "Interface.hh"
 #include "TransItem.hh"
 
+struct TopologyInfo;
+
 void reportPerf();
 #define STO_SHUTDOWN() reportPerf()
 
@@ -409,6 +496,15 @@ struct __attribute__((aligned(128))) threadinfo_t {
     std::function<void(void)> trans_end_callback;
     txp_counters p_;
     tc_counters tcs_;
+#if STO_TSC_PROFILE
+    LatencyHistogram lh_[lh_count];
+#endif
+    bool live;  // set in Transaction::live_threads_
+#if STO_TID_LEASE
+    tid_type lease_next;   // next TID in this thread's lease
+    tid_type lease_end;
+    epoch_type lease_epoch;
+#endif
     threadinfo_t() {
     }
 };
@@ -476,6 +572,49 @@ private:
     mutable std::vector<AccessBucket> access_buckets_;
 };
 
+// Growable array of TransItem pointers, in the order items were registered.
+// Pointers stay valid because tset chunks are never moved.
+class TsetIndex {
+public:
+    static constexpr unsigned initial_capacity = 512;
+
+    TsetIndex()
+        : items_(new TransItem*[initial_capacity]), size_(0), capacity_(initial_capacity) {}
+    ~TsetIndex() {
+        delete[] items_;
+    }
+    TsetIndex(const TsetIndex&) = delete;
+    TsetIndex& operator=(const TsetIndex&) = delete;
+
+    void push_back(TransItem* item) {
+        if (unlikely(size_ == capacity_))
+            grow();
+        items_[size_++] = item;
+    }
+    void clear() {
+        size_ = 0;
+    }
+    unsigned size() const {
+        return size_;
+    }
+    TransItem* operator[](unsigned i) const {
+        return items_[i];
+    }
+
+private:
+    TransItem** items_;
+    unsigned size_;
+    unsigned capacity_;
+
+    void grow() {
+        TransItem** items = new TransItem*[capacity_ * 2];
+        memcpy(items, items_, sizeof(TransItem*) * size_);
+        delete[] items_;
+        items_ = items;
+        capacity_ *= 2;
+    }
+};
+
 class Transaction {
 public:
     typedef TransactionTid::type tid_type;
@@ -486,6 +625,13 @@ public:
 
     static constexpr unsigned hash_size = 32779;
     static constexpr unsigned hash_step = 5;
+    typedef uint32_t hash_slot_type;
+#if TRANSACTION_FILTER
+    // 1024 bits; past filter_max_items the false positive rate climbs above
+    // ~10% and lookups no longer consult the filter
+    static constexpr unsigned filter_words = 16;
+    static constexpr unsigned filter_max_items = 192;
+#endif
     using epoch_type = TRcuSet::epoch_type;
     using signed_epoch_type = TRcuSet::signed_epoch_type;
 
@@ -501,6 +647,37 @@ private:
     static std::atomic<tid_type> _TID;
     static std::atomic<tid_type> _RTID;
     static unsigned us_per_epoch;  // Defaults to 100ms
+    static unsigned validate_every_;
+    static bool validate_checkpoints_;
+    static tid_type mvcc_read_lease_;
+#if STO_TID_LEASE
+    // Marks a wtid published by an idle thread for its lease (TIDs are
+    // multiples of TransactionTid::increment_value, so the bit is free)
+    static constexpr tid_type idle_lease_bit = 1;
+    // _TID at the start of each recent global epoch; no lease in use is below
+    // the floor of the epoch before the current one
+    static constexpr unsigned tid_floor_ring = 16;
+    static std::atomic<tid_type> tid_floor_[tid_floor_ring];
+#endif
+    // bitmap of tinfo slots that have started a transaction; the epoch
+    // advancer only scans these
+    static std::atomic<uint64_t> live_threads_[(MAX_THREADS + 63) / 64];
+    // RCU reclamation helpers (see start_rcu_helpers)
+    static bool rcu_offload_;
+    static std::vector<std::unique_ptr<TRcuReclaimer>> rcu_reclaimers_;
+    static std::vector<std::thread> rcu_helpers_;
+    // adaptive epoch period (see set_adaptive_epoch_cycle)
+    static std::unique_ptr<EpochController> epoch_controller_;
+    static struct epoch_control_stats {
+        uint64_t samples;
+        uint64_t period_total;
+        unsigned period_min;
+        unsigned period_max;
+        uint64_t backlog_max;
+        tid_type last_tid;
+        uint64_t last_flat_runs;
+        uint64_t last_flat_versions;
+    } epoch_control_stats_;
 public:
 
     static std::function<void(threadinfo_t::epoch_type)> epoch_advance_callback;
@@ -527,12 +704,28 @@ public:
         return ret;
     }
 
+#if STO_TSC_PROFILE
+    static LatencyHistogram latency_histogram_combined(int lh) {
+        LatencyHistogram out;
+        for (int i = 0; i != MAX_THREADS; ++i)
+            out.merge(tinfo[i].lh_[lh]);
+        return out;
+    }
+#endif
+
     static void print_stats();
+    // Latency histograms (combined and per thread) as a JSON object; values
+    // are TSC ticks. Prints {} unless built with STO_TSC_PROFILE.
+    static void print_latency_json(std::ostream& os, double tsc_ghz = PROC_TSC_FREQ);
 
     static void clear_stats() {
         for (int i = 0; i != MAX_THREADS; ++i) {
             tinfo[i].p_.reset();
             tinfo[i].tcs_.reset();
+#if STO_TSC_PROFILE
+            for (auto& h : tinfo[i].lh_)
+                h.reset();
+#endif
         }
     }
 
@@ -560,6 +753,24 @@ public:
     static void* epoch_advancer(void*);
     static void epoch_advance_once();
     static void global_epoch_advance_once();
+
+    template <typename F>
+    static void for_each_live_thread(F f) {
+        for (unsigned w = 0; w != arraysize(live_threads_); ++w) {
+            uint64_t bits = live_threads_[w].load(std::memory_order_acquire);
+            while (bits) {
+                f(tinfo[w * 64 + __builtin_ctzll(bits)]);
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    // Offload RCU callbacks to `per_node` helper threads on each NUMA node.
+    // Worker thread i hands its callbacks to a helper on node
+    // i % topo.num_nodes, matching set_affinity. Helpers take the highest
+    // TThread ids, which workers must not use. Call before the workers start;
+    // rcu_release_all stops the helpers.
+    static void start_rcu_helpers(const TopologyInfo& topo, unsigned per_node);
     template <typename T>
     static void rcu_delete(T* x) {
         auto& thr = this_thread();
@@ -605,16 +816,56 @@ public:
         return us_per_epoch;
     }
 
+    // Opt-in early abort for long OCC transactions: revalidate the read set
+    // after every every_n_reads new reads (0 = never) and, if checkpoints is
+    // set, at each Sto::checkpoint(). OCC only: MVCC checks need the
+    // commit TID and must not run during execution.
+    static void set_incremental_validation(unsigned every_n_reads, bool checkpoints) {
+        validate_every_ = every_n_reads;
+        validate_checkpoints_ = checkpoints;
+    }
+    static bool validate_at_checkpoints() {
+        return validate_checkpoints_;
+    }
+
+    // MVCC read validation leases. A committing reader that has to raise a
+    // version's rtid raises it `ntxns` transactions past its own commit TID,
+    // so readers committing within the lease leave the version untouched.
+    // Writers below the lease abort as if a reader had been there; after
+    // such an abort the object is read without leases until a write to it
+    // commits, so readers cannot starve writers. 0 keeps exact rtids.
+    static void set_mvcc_read_lease(unsigned ntxns) {
+        mvcc_read_lease_ = tid_type(ntxns) * TransactionTid::increment_value;
+    }
+    static tid_type mvcc_read_lease() {
+        return mvcc_read_lease_;
+    }
+    // Makes every TID taken from now on larger than `tid`
+    static void mvcc_skip_tids(tid_type tid) {
+        tid_type next = tid + TransactionTid::increment_value;
+        tid_type t;
+        do {
+            t = _TID;
+        } while (t < next && !_TID.compare_exchange_weak(t, next));
+    }
+
     static void set_epoch_cycle(const unsigned us) {
         fence();
         us_per_epoch = us;
         fence();
     }
 
+    // Let the epoch advancer tune us_per_epoch between params.min_us and
+    // params.max_us, starting from the current setting. Call before
+    // starting epoch_advancer.
+    static void set_adaptive_epoch_cycle(const EpochController::params_type& params);
+    static void adapt_epoch_cycle();
+
 
 private:
     static constexpr unsigned tset_chunk = 512;
     static constexpr unsigned tset_max_capacity = 32768;
+    static constexpr hash_slot_type hash_base_limit = ~hash_slot_type(0) - 2 * tset_max_capacity;
 
     void initialize();
 
@@ -658,27 +909,63 @@ private:
     // reset data so we can be reused for another transaction
     void start() {
         threadinfo_t& thr = this_thread();
+        if (unlikely(!thr.live))
+            register_live_thread();
         //if (isAborted_
         //   && tinfo[TThread::id()].p(txp_total_aborts) % 0x10000 == 0xFFFF)
            //print_stats();
 #if STO_TSC_PROFILE
         start_tsc_ = read_tsc();
+        if (!restarted || !first_start_tsc_)
+            first_start_tsc_ = start_tsc_;
 #endif
         special_txp = false;
-        // New committed versions “happen” in write_snapshot_epoch
-        thr.write_snapshot_epoch.store(global_epochs.global_epoch.load(std::memory_order_acquire), std::memory_order_release);
-        thr.epoch.store(global_epochs.read_epoch.load(std::memory_order_acquire), std::memory_order_release);
-        thr.rcu_set.clean_until(global_epochs.active_epoch.load(std::memory_order_acquire));
+        // New committed versions “happen” in write_snapshot_epoch. Only
+        // this thread writes its epochs, so skip the stores (and the cache
+        // line invalidation seen by the epoch advancer) if nothing changed.
+        auto ge = global_epochs.global_epoch.load(std::memory_order_acquire);
+        if (thr.write_snapshot_epoch.load(std::memory_order_relaxed) != ge)
+            thr.write_snapshot_epoch.store(ge, std::memory_order_release);
+        auto re = global_epochs.read_epoch.load(std::memory_order_acquire);
+        if (thr.epoch.load(std::memory_order_relaxed) != re)
+            thr.epoch.store(re, std::memory_order_release);
+        if (!rcu_offload_)
+            thr.rcu_set.clean_until(global_epochs.active_epoch.load(std::memory_order_acquire));
+        else
+            rcu_hand_off(thr);
+#if STO_TID_LEASE
+        // Any later commit TID comes from this lease or a newer one. The
+        // epoch is checked after publishing the lease: epoch_advance_once
+        // may have disregarded it as idle and stale, and then sees an epoch
+        // at least as new.
+        thr.wtid.store(thr.lease_next);
+        if (!lease_usable(thr, global_epochs.global_epoch.load())) {
+            thr.lease_next = thr.lease_end;
+            thr.wtid.store(_TID.load(std::memory_order_relaxed), std::memory_order_release);
+        }
+#else
         thr.wtid.store(_TID.load(std::memory_order_relaxed), std::memory_order_release);
+#endif
         if (thr.trans_start_callback)
             thr.trans_start_callback();
         hash_base_ += tset_size_ + 1;
+#if TRANSACTION_FILTER
+        if (tset_size_)
+            memset(filter_, 0, sizeof(filter_));
+#endif
         tset_size_ = 0;
+        reads_since_validate_ = 0;
         tset_next_ = tset0_;
+#if STO_TSET_INDEX
+        rindex_.clear();
+        windex_.clear();
+#endif
 #if CICADA_HASHTABLE
         cht_.clear();
 #elif TRANSACTION_HASHTABLE
-        if (hash_base_ >= hash_size) {
+        // slots are tagged with hash_base_, so stale entries from earlier
+        // transactions are ignored until the 32-bit tag space runs out
+        if (hash_base_ >= hash_base_limit) {
             memset(hashtable_, 0, sizeof(hashtable_));
             /*if (TThread::always_allocate()) {
                 memset(hashtable_1024_, 0, sizeof(hashtable_1024_)); 
@@ -690,11 +977,14 @@ private:
 #endif
         any_writes_ = any_nonopaque_ = may_duplicate_items_ = false;
         first_write_ = 0;
-        mvcc_rw_ = false;
+        mvcc_rw_ = mvcc_ro_ = false;
         if (commit_tid_ > 0)
             prev_commit_tid_ = commit_tid_;
         start_tid_ = read_tid_ = commit_tid_ = 0;
         tictoc_tid_ = 0;
+#if STO_TID_LEASE
+        installing_ = false;
+#endif
         buf_.clear();
 #if STO_DEBUG_ABORTS
         abort_item_ = nullptr;
@@ -731,13 +1021,39 @@ private:
 
     void refresh_tset_chunk();
 
+#if TRANSACTION_FILTER
+    // Both probe bits of a key live in one word, so a test is one load.
+    static uint64_t filter_hash(const TObject* obj, void* xkey) {
+        uint64_t h = reinterpret_cast<uintptr_t>(xkey) ^ (reinterpret_cast<uintptr_t>(obj) >> 4);
+        return h * 0x9E3779B97F4A7C15ULL;
+    }
+    static uint64_t filter_mask(uint64_t h) {
+        return (uint64_t(1) << ((h >> 48) & 63)) | (uint64_t(1) << ((h >> 42) & 63));
+    }
+    void filter_add(const TObject* obj, void* xkey) {
+        if (tset_size_ <= filter_max_items) {
+            uint64_t h = filter_hash(obj, xkey);
+            filter_[h >> 60] |= filter_mask(h);
+        }
+    }
+    // Returns false only if (obj, xkey) is certainly not in the tset.
+    bool filter_may_contain(const TObject* obj, void* xkey) const {
+        if (tset_size_ > filter_max_items)
+            return true;
+        uint64_t h = filter_hash(obj, xkey), m = filter_mask(h);
+        return (filter_[h >> 60] & m) == m;
+    }
+#endif
+
     void allocate_item_update_hash(const TObject* obj, void* xkey) {
+#if TRANSACTION_FILTER
+        filter_add(obj, xkey);
+#endif
 #if CICADA_HASHTABLE
         cht_.put(const_cast<TObject *>(obj), xkey, tset_size_ - 1);
 #else
 #if TRANSACTION_HASHTABLE
         unsigned hi = hash(obj, xkey);
-        //bitvector_[hi % bv_size] = true;
 # if TRANSACTION_HASHTABLE > 1
         if (hashtable_[hi] > hash_base_)
             hi = (hi + hash_step) % hash_size;
@@ -748,6 +1064,42 @@ private:
 #endif
     }
 
+#if STO_TSET_INDEX
+    void index_item(TransItem& item, TransItem::flags_type raised) {
+        if ((raised & TransItem::write_bit) && !(item.index_ & TransItem::in_write_index)) {
+            item.index_ |= TransItem::in_write_index;
+            windex_.push_back(&item);
+        }
+        if ((raised & (TransItem::read_bit | TransItem::predicate_bit))
+            && !(item.index_ & TransItem::in_read_index)) {
+            item.index_ |= TransItem::in_read_index;
+            rindex_.push_back(&item);
+        }
+    }
+#endif
+
+    static void register_live_thread();
+    static void rcu_hand_off(threadinfo_t& thr);
+    static void rcu_helper(unsigned index, std::vector<int> cpus);
+    static void rcu_reclaim_pass(threadinfo_t& thr, TRcuReclaimer& reclaimer);
+
+#if STO_TSET_SIMD
+    struct alignas(64) TsetShadow {
+        uintptr_t owner[tset_chunk];
+        uintptr_t key[tset_chunk];
+    };
+    enum { simd_none = 0, simd_avx2, simd_avx512 };
+    static int tset_simd_;
+    static int detect_tset_simd();
+
+    void shadow_item(unsigned tidx, const TObject* obj, void* xkey) {
+        TsetShadow* sh = shadow_[tidx / tset_chunk];
+        sh->owner[tidx % tset_chunk] = reinterpret_cast<uintptr_t>(obj);
+        sh->key[tidx % tset_chunk] = reinterpret_cast<uintptr_t>(xkey);
+    }
+    TransItem* find_item_simd(TObject* obj, void* xkey) const;
+#endif
+
     TransItem* allocate_item(const TObject* obj, void* xkey) {
 	    //TXP_INCREMENT(txp_allocate);
         if (tset_size_ && tset_size_ % tset_chunk == 0)
@@ -756,6 +1108,9 @@ private:
         new(reinterpret_cast<void*>(tset_next_)) TransItem(const_cast<TObject*>(obj), xkey);
         //tset_next_->s_ = reinterpret_cast<TransItem::ownerstore_type>(const_cast<TObject*>(obj));
         //tset_next_->key_ = xkey;
+#if STO_TSET_SIMD
+        shadow_item(tset_size_ - 1, obj, xkey);
+#endif
         allocate_item_update_hash(obj, xkey);
         return tset_next_++;
     }
@@ -810,6 +1165,12 @@ private:
         void* xkey = Packer<T>::pack_unique(buf_, std::move(key));
         TXP_INCREMENT(txp_hash_find);
         unsigned hi = hash(obj, xkey);
+#  if TRANSACTION_FILTER
+        bool filter_pass = filter_may_contain(obj, xkey);
+        if (!filter_pass)
+            TXP_INCREMENT(txp_bv_hit);
+        else
+#  endif
         if (hashtable_[hi] > hash_base_) {
             unsigned tidx =  hashtable_[hi] - hash_base_ - 1;
             if (likely(tidx < tset_initial_capacity))
@@ -821,23 +1182,29 @@ private:
             } else {
 # endif
 	        //std::cout << "Hash not found!" << std::endl;
-                for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
-                    ti = (tidx % tset_chunk ? ti + 1 : tset_[tidx / tset_chunk]);
-                    TXP_INCREMENT(txp_total_searched);
-                    if (ti->owner() == obj && ti->key_ == xkey) {
-                        found = true;
-                        break;
-                    }
+                if (TransItem* sti = find_item_scan(const_cast<TObject*>(obj), xkey)) {
+                    ti = sti;
+                    found = true;
                 }
 # if TRANSACTION_HASHTABLE
             }
         }
 # endif
         if (!found) {
+#  if TRANSACTION_FILTER
+            if (filter_pass && tset_size_ <= filter_max_items)
+                TXP_INCREMENT(txp_bv_false_positive);
+#  endif
             if (tset_size_ && tset_size_ % tset_chunk == 0)
                 refresh_tset_chunk();
             ++tset_size_;
             new(reinterpret_cast<void*>(tset_next_)) TransItem(const_cast<TObject*>(obj), xkey);
+#  if STO_TSET_SIMD
+            shadow_item(tset_size_ - 1, obj, xkey);
+#  endif
+#  if TRANSACTION_FILTER
+            filter_add(obj, xkey);
+#  endif
 # if TRANSACTION_HASHTABLE
             if (hashtable_[hi] <= hash_base_)
                 hashtable_[hi] = hash_base_ + tset_size_;
@@ -874,6 +1241,10 @@ private:
 
 private:
     TransItem* find_item_scan(TObject* obj, void* xkey) const {
+#if STO_TSET_SIMD
+        if (tset_simd_ != simd_none)
+            return find_item_simd(obj, xkey);
+#endif
         const TransItem* it = nullptr;
         for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
             it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
@@ -888,6 +1259,21 @@ private:
 #if STO_TSC_PROFILE
         TimeKeeper<tc_find_item> tk;
 #endif
+#if TRANSACTION_FILTER
+        if (tset_size_ <= filter_max_items) {
+            if (!filter_may_contain(obj, xkey)) {
+                TXP_INCREMENT(txp_bv_hit);
+                return nullptr;
+            }
+            TransItem* ti = find_item_probe(obj, xkey);
+            if (!ti)
+                TXP_INCREMENT(txp_bv_false_positive);
+            return ti;
+        }
+#endif
+        return find_item_probe(obj, xkey);
+    }
+    TransItem* find_item_probe(TObject* obj, void* xkey) const {
 #if CICADA_HASHTABLE
         return cht_.find(obj, xkey);
 #else
@@ -1003,7 +1389,7 @@ public:
         assert(state_ <= s_committing_locked);
         TXP_INCREMENT(txp_tco);
         if (!start_tid_)
-            start_tid_ = _TID.load(std::memory_order_relaxed);
+            start_tid_ = opacity_start_tid();
         if (!TransactionTid::try_check_opacity(start_tid_, v)
             && state_ < s_committing)
             return hard_check_opacity(&item, v);
@@ -1022,7 +1408,7 @@ public:
     bool check_opacity(TransactionTid::type v) {
         assert(state_ <= s_committing_locked);
         if (!start_tid_)
-            start_tid_ = _TID.load(std::memory_order_relaxed);
+            start_tid_ = opacity_start_tid();
         if (!TransactionTid::try_check_opacity(start_tid_, v)
             && state_ < s_committing)
             return hard_check_opacity(nullptr, v);
@@ -1033,10 +1419,30 @@ public:
         return check_opacity(_TID.load(std::memory_order_relaxed));
     }
 
+    // Called by OCC versions after registering a new read. Returns false if
+    // incremental validation found a stale read; the caller should abort.
+    bool note_read() {
+        if (likely(!validate_every_) || state_ != s_in_progress
+            || ++reads_since_validate_ < validate_every_)
+            return true;
+        return validate_reads();
+    }
+    // Checks the reads and predicates registered so far.
+    bool validate_reads();
+
     // flips the manual rw flag for mvcc
     void mvcc_rw_upgrade() const {
+        assert(!mvcc_ro_);
         mvcc_rw_ = true;
     }
+    // declares a read-only snapshot transaction (see ROTRANSACTION)
+    void mvcc_ro_snapshot() const {
+        assert(!mvcc_rw_);
+        mvcc_ro_ = true;
+    }
+    bool mvcc_ro() const {
+        return mvcc_ro_;
+    }
 
     // transaction start
     tid_type read_tid() const {
@@ -1054,16 +1460,70 @@ public:
         return read_tid_;
     }
 
+    // Lower bound on the TID of any transaction that commits after this
+    // call; versions at or above it may be newer than our reads.
+    static tid_type opacity_start_tid() {
+#if STO_TID_LEASE
+        while (true) {
+            epoch_type ge = global_epochs.global_epoch.load(std::memory_order_acquire);
+            tid_type floor = tid_floor_[(ge - 1) % tid_floor_ring].load(std::memory_order_acquire);
+            // retry if the ring wrapped around while we read it
+            if (global_epochs.global_epoch.load(std::memory_order_acquire) - ge < tid_floor_ring - 1)
+                return floor;
+        }
+#else
+        return _TID.load(std::memory_order_relaxed);
+#endif
+    }
+
     // transaction is now a read-write transaction
     tid_type write_tid() const {
         if (!commit_tid_) {
+#if STO_TSC_PROFILE
+            TimeKeeper<tc_tid_alloc> tk;
+#endif
             threadinfo_t& thr = this_thread();
+#if STO_TID_LEASE
+            // A lease TID can be older than TIDs other threads have used.
+            // That is harmless once the transaction holds its write locks
+            // and has checked its reads, as under OCC, where the TID only
+            // stamps the installed versions. Earlier requests come from
+            // MVCC, which orders transactions by TID, so they take the next
+            // global TID. The lease is dropped so wtid stays a lower bound.
+            if (installing_) {
+                commit_tid_ = lease_tid(thr);
+            } else {
+                thr.lease_next = thr.lease_end;
+                commit_tid_ = _TID.fetch_add(TransactionTid::increment_value);
+            }
+#else
             commit_tid_ = _TID.fetch_add(TransactionTid::increment_value);
+#endif
             thr.wtid.store(commit_tid_, std::memory_order_release);
         }
         return commit_tid_;
     }
 
+#if STO_TID_LEASE
+    // a lease may only be used through the epoch after the one it was
+    // taken in, so opacity_start_tid() stays a lower bound
+    static bool lease_usable(const threadinfo_t& thr, epoch_type ge) {
+        return thr.lease_next != thr.lease_end && signed_epoch_type(ge - thr.lease_epoch) <= 1;
+    }
+    static tid_type lease_tid(threadinfo_t& thr) {
+        epoch_type ge = global_epochs.global_epoch.load(std::memory_order_acquire);
+        if (!lease_usable(thr, ge)) {
+            TXP_INCREMENT(txp_tid_lease_refills);
+            thr.lease_next = _TID.fetch_add(STO_TID_LEASE * TransactionTid::increment_value);
+            thr.lease_end = thr.lease_next + STO_TID_LEASE * TransactionTid::increment_value;
+            thr.lease_epoch = ge;
+        }
+        tid_type tid = thr.lease_next;
+        thr.lease_next += TransactionTid::increment_value;
+        return tid;
+    }
+#endif
+
     // committing
     tid_type commit_tid() const {
 #if !CONSISTENCY_CHECK
@@ -1193,7 +1653,7 @@ private:
     };
 
     int threadid_;
-    uint16_t hash_base_;
+    hash_slot_type hash_base_;
     uint16_t first_write_;
     uint8_t state_;
     bool any_writes_;
@@ -1205,12 +1665,17 @@ private:
     bool restarted;
     TransItem* tset_next_;
     unsigned tset_size_;
+    unsigned reads_since_validate_;
     mutable bool mvcc_rw_;  // manual MVCC read-write flag
+    mutable bool mvcc_ro_;  // MVCC read-only snapshot flag
     mutable tid_type start_tid_;
     mutable tid_type read_tid_;
     mutable tid_type commit_tid_;
     mutable tid_type prev_commit_tid_;
     mutable tid_type tictoc_tid_; // commit tid reserved for TicToc
+#if STO_TID_LEASE
+    bool installing_;  // commit phase 3: all write locks held, reads checked
+#endif
 public:
     mutable TransactionBuffer buf_;
     mutable TransScratch scratch_;
@@ -1223,18 +1688,31 @@ private:
 #endif
 #if STO_TSC_PROFILE
     mutable tc_counter_type start_tsc_;
+    tc_counter_type first_start_tsc_;  // 0 after a commit
 #endif
     TransItem* tset_[tset_max_capacity / tset_chunk];
+#if STO_TSET_SIMD
+    TsetShadow shadow0_[tset_initial_capacity / tset_chunk];
+    TsetShadow* shadow_[tset_max_capacity / tset_chunk];
+#endif
+#if STO_TSET_INDEX
+    TsetIndex rindex_;  // items with read or predicate flags
+    TsetIndex windex_;  // items with write flags
+#endif
 #if CICADA_HASHTABLE
     CicadaHashtable cht_;
 #else
 #if TRANSACTION_HASHTABLE
-    uint16_t hashtable_[hash_size];
+    hash_slot_type hashtable_[hash_size];
+#endif
 #endif
+#if TRANSACTION_FILTER
+    uint64_t filter_[filter_words];
 #endif
     TransItem tset0_[tset_initial_capacity];
 
     bool hard_check_opacity(TransItem* item, TransactionTid::type t);
+    TransItem* stale_read_item();
     void stop(bool committed, unsigned* writes, unsigned nwrites);
 
     friend class TransProxy;
@@ -1242,6 +1720,8 @@ private:
     friend class Sto;
     friend class TestTransaction;
     friend class MvHistoryBase;
+    friend class MvRegistry;
+    friend class MvFlattenPool;
     friend class CicadaHashtable;
 
     friend class VersionDelegate;
@@ -1317,13 +1797,21 @@ void CicadaHashtable::put(TObject* owner, void* xkey, uint32_t idx) {
     bkt->idx[bkt->count++] = idx;
 }
 
+#if STO_TSET_INDEX
+inline void TransItem::__index_flags(flags_type raised) {
+    TThread::txn->index_item(*this, raised);
+}
+#endif
 
 template <int T, bool tmp_stats>
 inline void TimeKeeper<T, tmp_stats>::sync_thread_counter() {
-    tc_helper<T, tc_count>::account_array(
-        Transaction::tinfo[TThread::id()].tcs_.tcs_,
-        read_tsc() - init_tsc
-    );
+    auto& thr = Transaction::tinfo[TThread::id()];
+    auto ticks = read_tsc() - init_tsc;
+    tc_helper<T, tc_count>::account_array(thr.tcs_.tcs_, ticks);
+#if STO_TSC_PROFILE
+    if (tc_latency_histogram(T) >= 0)
+        thr.lh_[tc_latency_histogram(T)].record(ticks);
+#endif
 }
 
 template <int T, bool tmp_stats>
@@ -1393,6 +1881,14 @@ public:
         TThread::txn->check_opacity();
     }
 
+    // Incremental validation checkpoint: returns false if checkpoints are
+    // enabled (Transaction::set_incremental_validation) and a read is
+    // already stale, in which case the transaction should abort now.
+    static bool checkpoint() {
+        always_assert(in_progress());
+        return !Transaction::validate_at_checkpoints() || TThread::txn->validate_reads();
+    }
+
     template <typename T>
     static OptionalTransProxy check_item(const TObject* s, T key) {
         always_assert(in_progress());
@@ -1440,6 +1936,15 @@ public:
         TThread::txn->mvcc_rw_upgrade();
     }
 
+    static void mvcc_ro_snapshot() {
+        always_assert(in_progress());
+        TThread::txn->mvcc_ro_snapshot();
+    }
+
+    static bool mvcc_ro() {
+        return TThread::txn->mvcc_ro();
+    }
+
     static TransactionTid::type read_tid() {
         return TThread::txn->read_tid();
     }
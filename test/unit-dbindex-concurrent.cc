@@ -422,7 +422,234 @@ void IndexTester<MVCC, Ordered>::RunTests() {
     Transaction::rcu_release_all(epoch_advancer_thread, num_writers + num_readers);
 }
 
+// Inserts from several threads into an unordered index that starts with a
+// few buckets, so the inserts race with bucket splits, then deletes some of
+// the rows.
+template <typename DBParams>
+class GrowthTester {
+public:
+    static constexpr size_t index_init_size = 16;
+    static constexpr int num_threads = 4;
+    static constexpr int32_t keys_per_thread = 20000;
+    static constexpr int32_t num_stable_keys = 512;
+    static constexpr bool MVCC = DBParams::MVCC;
+
+    using index_type = typename std::conditional_t<MVCC,
+                                  mvcc_unordered_index<index_key, index_value, DBParams>,
+                                  unordered_index<index_key, index_value, DBParams>>;
+    typedef index_value::NamedColumn nc;
+
+    GrowthTester() : idx_(index_init_size) {}
+
+    void RunTests();
+
+private:
+    void InserterThread(int thread_id);
+    void SnapshotLookupThread(int thread_id, std::atomic<bool>& stop);
+    bool Delete(const index_key& key);
+    bool Lookup(const index_key& key, int64_t* value_1);
+    void MultiLookup();
+
+    index_type idx_;
+};
+
+template <typename DBParams>
+void GrowthTester<DBParams>::InserterThread(int thread_id) {
+    TThread::set_id(thread_id);
+    for (int32_t i = 0; i < keys_per_thread; ++i) {
+        index_value val(i);
+        RWTRANSACTION {
+            auto [success, found] = idx_.insert_row(index_key(thread_id, i), &val);
+            TXN_DO(success);
+            assert(!found);
+        } RETRY(true);
+    }
+}
+
+// Looks up rows inserted before the growth began in read-only
+// transactions, which take no bucket observations to check at commit, so
+// a lookup that loses a key to a concurrent split is never retried.
+template <typename DBParams>
+void GrowthTester<DBParams>::SnapshotLookupThread(int thread_id, std::atomic<bool>& stop) {
+    static constexpr int32_t batch = 16;
+    TThread::set_id(thread_id);
+    std::vector<index_key> keys;
+    uintptr_t rows[batch];
+    while (!stop.load()) {
+        for (int32_t base = 0; base < num_stable_keys; base += batch) {
+            keys.clear();
+            for (int32_t i = base; i < base + batch; ++i)
+                keys.emplace_back(num_threads + 2, i);
+            ROTRANSACTION {
+                TXN_DO(idx_.multi_select_row(keys.data(), batch, rows));
+                for (int32_t i = 0; i < batch; ++i) {
+                    always_assert(rows[i], "key missed during growth");
+                    auto [success, result, row, accessor]
+                        = idx_.select_split_row(keys[i], {{nc::value_1, access_t::read}});
+                    TXN_DO(success);
+                    (void)row;
+                    always_assert(result, "key missed during growth");
+                    always_assert(accessor.value_1() == base + i, "key has the wrong value");
+                }
+            } RETRY(true);
+        }
+    }
+}
+
+template <typename DBParams>
+bool GrowthTester<DBParams>::Delete(const index_key& key) {
+    bool found = false;
+    RWTRANSACTION {
+        auto [success, result] = idx_.delete_row(key);
+        TXN_DO(success);
+        found = result;
+    } RETRY(true);
+    return found;
+}
+
+template <typename DBParams>
+bool GrowthTester<DBParams>::Lookup(const index_key& key, int64_t* value_1) {
+    bool found = false;
+    RWTRANSACTION {
+        auto [success, result, row, accessor]
+            = idx_.select_split_row(key, {{nc::value_1, access_t::read}});
+        TXN_DO(success);
+        (void)row;
+        found = result;
+        if (result)
+            *value_1 = accessor.value_1();
+    } RETRY(true);
+    return found;
+}
+
+// Looks up thread 0's keys, half of them deleted, and some absent keys in
+// batches that do not divide the index's prefetch batch
+template <typename DBParams>
+void GrowthTester<DBParams>::MultiLookup() {
+    static constexpr int32_t batch = 37;
+    std::vector<index_key> keys;
+    uintptr_t rows[batch];
+    for (int32_t base = 0; base < keys_per_thread + batch; base += batch) {
+        keys.clear();
+        for (int32_t i = base; i < base + batch; ++i)
+            keys.emplace_back(i < keys_per_thread ? 0 : num_threads, i);
+        RWTRANSACTION {
+            TXN_DO(idx_.multi_select_row(keys.data(), batch, rows));
+            for (int32_t i = 0; i < batch; ++i) {
+                int32_t k = base + i;
+                bool present = k < keys_per_thread && k % 2 == 1;
+                // deleted rows may stay in the index for a while
+                if (!rows[i]) {
+                    always_assert(!present, "inserted key missing");
+                    continue;
+                }
+                always_assert(k < keys_per_thread, "absent key found");
+                auto [success, result, row, accessor]
+                    = idx_.select_split_row(rows[i], {{nc::value_1, access_t::read}});
+                TXN_DO(success);
+                (void)row;
+                always_assert(result == present, "delete went wrong");
+                if (result)
+                    always_assert(accessor.value_1() == k, "inserted key has the wrong value");
+            }
+        } RETRY(true);
+    }
+}
+
+template <typename DBParams>
+void GrowthTester<DBParams>::RunTests() {
+    TThread::set_id(0);
+    for (int32_t i = 0; i < num_stable_keys; ++i) {
+        index_value val(i);
+        RWTRANSACTION {
+            auto [success, found] = idx_.insert_row(index_key(num_threads + 2, i), &val);
+            TXN_DO(success && !found);
+        } RETRY(true);
+    }
+    // let read-only snapshots see those rows
+    Transaction::epoch_advance_once();
+
+    std::vector<std::thread> inserters;
+    std::atomic<bool> stop = false;
+    for (int i = 0; i < num_threads; ++i) {
+        inserters.emplace_back(&GrowthTester<DBParams>::InserterThread, this, i);
+    }
+    std::thread looker(&GrowthTester<DBParams>::SnapshotLookupThread, this, num_threads, std::ref(stop));
+    for (auto& t : inserters) {
+        t.join();
+    }
+    stop.store(true);
+    looker.join();
+
+    TThread::set_id(0);
+    // the table keeps under max_load nodes per bucket, so even growing
+    // late it ends up with at least half the buckets that needs
+    size_t nrows = num_threads * keys_per_thread + num_stable_keys;
+    always_assert(idx_.nbuckets() >= nrows / (2 * index_type::max_load()), "index did not grow");
+    for (int t = 0; t < num_threads; ++t) {
+        for (int32_t i = 0; i < keys_per_thread; ++i) {
+            int64_t v = -1;
+            always_assert(Lookup(index_key(t, i), &v), "inserted key missing");
+            always_assert(v == i, "inserted key has the wrong value");
+        }
+    }
+    int64_t v;
+    always_assert(!Lookup(index_key(num_threads, 0), &v), "absent key found");
+
+    // An absent key observed before its bucket is split is a phantom
+    // afterwards. Splits go in bucket order, so pick a key whose bucket
+    // is among the next to split.
+    if constexpr (!MVCC) {
+        static constexpr int32_t num_late_inserts = 2048;
+        size_t nbuckets = idx_.nbuckets();
+        size_t level_size = index_init_size;
+        while (level_size * 2 <= nbuckets)
+            level_size *= 2;
+        size_t next_split = nbuckets - level_size;
+        int32_t j = 0;
+        while (idx_.find_bucket_idx(index_key(num_threads, j)) - next_split >= num_late_inserts / 8)
+            ++j;
+
+        TestTransaction t1(0);
+        auto [success, result, row, accessor]
+            = idx_.select_split_row(index_key(num_threads, j), {{nc::value_1, access_t::read}});
+        (void)row;
+        (void)accessor;
+        assert(success && !result);
+        TestTransaction t2(1);
+        for (int32_t i = 0; i < num_late_inserts; ++i) {
+            index_value val(i);
+            auto [ok, found] = idx_.insert_row(index_key(num_threads + 1, i), &val);
+            assert(ok && !found);
+        }
+        assert(t2.try_commit());
+        assert(idx_.nbuckets() > nbuckets + num_late_inserts / 8);
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    for (int32_t i = 0; i < keys_per_thread; i += 2) {
+        always_assert(Delete(index_key(0, i)), "inserted key missing");
+    }
+    for (int32_t i = 0; i < keys_per_thread; ++i) {
+        always_assert(Lookup(index_key(0, i), &v) == (i % 2 == 1), "delete went wrong");
+    }
+    MultiLookup();
+
+    std::cout << "Growth test (" << (MVCC ? "MVCC" : "OCC")
+              << (DBParams::SlotBuckets ? " slot buckets" : "") << ", "
+              << idx_.nbuckets() << " buckets) pass!" << std::endl;
+}
+
 int main() {
+    // the indexes must outlive the RCU callbacks run at the end
+    GrowthTester<db_params::db_default_commute_params> occ_growth;
+    occ_growth.RunTests();
+    GrowthTester<db_params::db_default_commute_slot_params> slot_growth;
+    slot_growth.RunTests();
+    GrowthTester<db_params::db_mvcc_commute_params> mvcc_growth;
+    mvcc_growth.RunTests();
+
     IndexTester<true, true> tester;
     tester.RunTests();
 }
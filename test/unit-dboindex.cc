@@ -762,6 +762,68 @@ void test_mvcc_snapshot() {
     printf("pass %s\n", __FUNCTION__);
 }
 
+void test_mvcc_ro_snapshot() {
+    typedef CoarseIndex::NamedColumn nc;
+    MVIndex mi;
+    mi.thread_init();
+
+    init_cindex(mi);
+
+    {
+        TestTransaction t1(0);
+        Sto::mvcc_ro_snapshot();
+        {
+            auto [success, found, row, value] = mi.select_split_row(key_type(1), {{nc::aa, access_t::read}});
+            (void) row;
+            assert(success && found);
+            assert(value.aa() == 1);
+        }
+        {
+            auto [success, found, row, value] = mi.select_split_row(key_type(200), {{nc::aa, access_t::read}});
+            (void) row;
+            (void) value;
+            assert(success && !found);
+        }
+
+        TestTransaction t2(1);
+        {
+            auto [success, found, row, value] = mi.select_split_row(key_type(1), {{nc::aa, access_t::update}});
+            assert(success && found);
+            auto new_row = Sto::tx_alloc<coarse_grained_row>();
+            value.copy_into(new_row);
+            new_row->aa = 2;
+            mi.update_row(row, new_row);
+            coarse_grained_row row_value(200, 200, 200);
+            auto [isuccess, ifound] = mi.insert_row(key_type(200), &row_value);
+            assert(isuccess && !ifound);
+            assert(t2.try_commit());
+        }
+
+        // the snapshot sees neither the update nor the insert
+        t1.use();
+        {
+            auto [success, found, row, value] = mi.select_split_row(key_type(1), {{nc::aa, access_t::read}});
+            (void) row;
+            assert(success && found);
+            assert(value.aa() == 1);
+        }
+        {
+            int count = 0;
+            auto scan_callback = [&count] (const key_type&, const auto&) -> bool {
+                ++count;
+                return true;
+            };
+            bool success = mi.template range_scan<decltype(scan_callback), false>(key_type(1), key_type(1000),
+                    scan_callback, {{nc::aa, access_t::read}});
+            assert(success);
+            assert(count == 10);
+        }
+        assert(t1.try_commit());
+    }
+
+    printf("pass %s\n", __FUNCTION__);
+}
+
 int main() {
     test_coarse_basic();
     test_coarse_read_my_split();
@@ -773,6 +835,7 @@ int main() {
     test_fine_delete0();
     test_fine_delete1();
     test_mvcc_snapshot();
+    test_mvcc_ro_snapshot();
     printf("All tests pass!\n");
 
     std::thread advancer;  // empty thread because we have no advancer thread
@@ -161,6 +161,66 @@ void testNoOpacity1() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testIncrementalValidation() {
+    TBox<int, TNonopaqueWrapped<int> > f, g, h;
+    TBox<int, TNonopaqueWrapped<int> > box;
+    Transaction::set_incremental_validation(2, true);
+
+    // the second new read revalidates and finds f stale
+    try {
+        TestTransaction t1(1);
+        int x = f;
+        assert(x == 0);
+        box = 9; /* avoid read-only txn */
+
+        TestTransaction t(2);
+        f = 2;
+        assert(t.try_commit());
+
+        t1.use();
+        x = g;
+        assert(false && "shouldn't get here");
+    } catch (Transaction::Abort e) {
+        TestTransaction::hard_reset();
+    }
+
+    // checkpoints validate regardless of the read count
+    {
+        TestTransaction t1(1);
+        int x = g;
+        assert(x == 0);
+        assert(Sto::checkpoint());
+
+        TestTransaction t(2);
+        g = 3;
+        assert(t.try_commit());
+
+        t1.use();
+        assert(!Sto::checkpoint());
+        t1.get_tx().silent_abort();
+        TestTransaction::hard_reset();
+    }
+
+    Transaction::set_incremental_validation(0, false);
+    {
+        TestTransaction t1(1);
+        int x = f;
+        assert(x == 2);
+        box = 10;
+
+        TestTransaction t(2);
+        f = 4;
+        assert(t.try_commit());
+
+        t1.use();
+        x = g + h;
+        assert(Sto::checkpoint());
+        assert(!t1.try_commit());
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 #if 0
 void testStringWrapper() {
     TBox<std::string> f;
@@ -255,6 +315,7 @@ int main() {
     testConcurrentInt();
     testOpacity1();
     testNoOpacity1();
+    testIncrementalValidation();
     //testStringWrapper();
 
     std::thread advancer;  // empty thread because we have no advancer thread
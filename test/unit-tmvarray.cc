@@ -288,6 +288,50 @@ void testMvInline() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testSlice() {
+    TestArray<int, 64> f;
+    TMvBox<int> g;
+    for (int i = 0; i < 64; ++i)
+        f.nontrans_put(i, i);
+    g.nontrans_write(0);
+
+    int buf[32];
+    {
+        TransactionGuard t;
+        Sto::mvcc_rw_upgrade();
+        f[10] = 100;
+        f.transGet_slice(8, 40, buf);
+        for (int i = 8; i < 40; ++i)
+            assert(buf[i - 8] == (i == 10 ? 100 : i));
+    }
+
+    // The slice is validated: a write by an older transaction, installed
+    // after the slice read, aborts it
+    {
+        TestTransaction t1(1);
+        Sto::mvcc_rw_upgrade();
+        int x = f[50];
+        assert(x == 50);
+
+        TestTransaction t2(2);
+        Sto::mvcc_rw_upgrade();
+        f.transGet_slice(16, 32, buf);
+        assert(buf[4] == 20);
+        f.transGet_slice(16, 32, buf);  // repeated slice rereads the same versions
+        assert(buf[4] == 20);
+        g = 1;
+
+        t1.use();
+        f[20] = -1;
+        assert(t1.try_commit());
+
+        t2.use();
+        assert(!t2.try_commit());
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 void benchArray64() {
     TMvArray<int, 64> a;
     for (int i = 0; i < 64; ++i)
@@ -322,6 +366,7 @@ int main() {
     testConflictingModifyIter2();
     testConflictingModifyIter3();
     testOpacity1();
+    testSlice();
 #if MVCC_INLINING
     testMvInline();
 #endif
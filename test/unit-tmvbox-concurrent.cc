@@ -6,9 +6,11 @@
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <random>
 #include "Sto.hh"
 #include "Commutators.hh"
 #include "TMvBox.hh"
+#include "TBox.hh"
 
 typedef TMvCommuteIntegerBox tbox_t;
 using namespace std::chrono_literals;
@@ -64,6 +66,372 @@ void ReaderThread(int thread_id, tbox_t& box, std::atomic<bool>& stop) {
     }
 }
 
+#define LATEST_WRITES_PER_THREAD 20000
+
+// Non-commutative read-modify-write updates, so every committed version is
+// flattened and the cached latest version changes on every install.
+void LatestWriterThread(int thread_id, TMvBox<int64_t>& box) {
+    TThread::set_id(thread_id);
+
+    for (size_t i = 0; i < LATEST_WRITES_PER_THREAD; ++i) {
+        RWTRANSACTION {
+            auto [success, v] = box.read_nothrow();
+            TXN_DO(success);
+            box = v + 1;
+        } RETRY(true);
+    }
+}
+
+void LatestReaderThread(int thread_id, TMvBox<int64_t>& box, std::atomic<bool>& stop) {
+    TThread::set_id(thread_id);
+
+    int64_t value_so_far = 0;
+    while (!stop.load()) {
+        TRANSACTION {
+            auto h = TMvBoxAccess::latest(box, false);
+            assert(h->status_is(COMMITTED));
+            int64_t v = h->v();
+            assert(v >= value_so_far);
+            auto hw = TMvBoxAccess::latest(box, true);
+            assert(hw->status_is(COMMITTED));
+            assert(hw->v() >= v);
+            value_so_far = hw->v();
+        } RETRY(true);
+    }
+}
+
+void testLatestCache() {
+    std::vector<std::thread> thrs;
+    std::atomic<bool> stop = false;
+    TMvBox<int64_t> box;
+    box.nontrans_write(0);
+
+    for (int i = 0; i < NUM_WRITER_THREADS; ++i) {
+        thrs.emplace_back(LatestWriterThread, i, std::ref(box));
+    }
+    for (int i = NUM_WRITER_THREADS; i < NUM_WRITER_THREADS + 2; ++i) {
+        thrs.emplace_back(LatestReaderThread, i, std::ref(box), std::ref(stop));
+    }
+    for (int i = 0; i < NUM_WRITER_THREADS; ++i) {
+        thrs[i].join();
+    }
+    stop.store(true);
+    for (int i = NUM_WRITER_THREADS; i < NUM_WRITER_THREADS + 2; ++i) {
+        thrs[i].join();
+    }
+
+    assert(box.nontrans_read() == NUM_WRITER_THREADS * LATEST_WRITES_PER_THREAD);
+    std::cout << "Latest cache test pass!" << std::endl;
+}
+
+#define SNAPSHOT_WRITES_PER_THREAD 3000
+
+// Writes the same value to both boxes, alternating MVCC and OCC
+// transactions and sleeping at random so the thread often sits idle with
+// TIDs left in its lease (STO_TID_LEASE).
+void SnapshotWriterThread(int thread_id, TMvBox<int64_t>& f, TMvBox<int64_t>& g) {
+    TThread::set_id(thread_id);
+    std::mt19937 gen(thread_id);
+
+    for (int64_t i = 1; i <= SNAPSHOT_WRITES_PER_THREAD; ++i) {
+        int64_t v = i * NUM_WRITER_THREADS + thread_id;
+        if (thread_id % 2) {
+            RWTRANSACTION {
+                f = v;
+                g = v;
+            } RETRY(true);
+        } else {
+            TRANSACTION {
+                f = v;
+                g = v;
+            } RETRY(true);
+        }
+        if (gen() % 4 == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(gen() % 2000));
+        }
+    }
+}
+
+void SnapshotReaderThread(int thread_id, TMvBox<int64_t>& f, TMvBox<int64_t>& g,
+                          std::atomic<bool>& stop) {
+    TThread::set_id(thread_id);
+
+    while (!stop.load()) {
+        int64_t a = -1, b = -2;
+        ROTRANSACTION {
+            a = f;
+            b = g;
+        } RETRY(true);
+        assert(a == b);
+    }
+}
+
+// Read-only snapshots must never see half of a writer's commit, even when
+// idle writers hold TID leases below the snapshot.
+void testSnapshot() {
+    std::vector<std::thread> thrs;
+    std::atomic<bool> stop = false;
+    TMvBox<int64_t> f, g;
+    f.nontrans_write(0);
+    g.nontrans_write(0);
+
+    for (int i = 0; i < NUM_WRITER_THREADS; ++i) {
+        thrs.emplace_back(SnapshotWriterThread, i, std::ref(f), std::ref(g));
+    }
+    thrs.emplace_back(SnapshotReaderThread, NUM_WRITER_THREADS, std::ref(f), std::ref(g), std::ref(stop));
+    for (int i = 0; i < NUM_WRITER_THREADS; ++i) {
+        thrs[i].join();
+    }
+    stop.store(true);
+    thrs[NUM_WRITER_THREADS].join();
+
+    std::cout << "Snapshot test pass!" << std::endl;
+}
+
+// A thread that commits under OCC and then goes idle keeps the rest of its
+// TID lease (STO_TID_LEASE). Once the lease is stale it must not hold back
+// _RTID, or read-only snapshots stop seeing new commits.
+void testIdleLease() {
+    TMvBox<int64_t> box;
+    TBox<int64_t> occ_box;
+    box.nontrans_write(0);
+
+    std::thread idle([&occ_box] {
+        TThread::set_id(1);
+        TRANSACTION {
+            occ_box = 1;
+        } RETRY(true);
+    });
+    idle.join();
+
+    TThread::set_id(0);
+    for (int64_t i = 2; i <= 100; ++i) {
+        RWTRANSACTION {
+            box = i;
+        } RETRY(true);
+        std::this_thread::sleep_for(100us);
+    }
+    // let a few epochs pass
+    std::this_thread::sleep_for(20ms);
+
+    int64_t v = -1;
+    ROTRANSACTION {
+        v = box;
+    } RETRY(true);
+    assert(v == 100);
+    std::cout << "Idle lease test pass!" << std::endl;
+}
+
+#define SAMPLED_WRITES 50
+
+// Chain sampling with garbage collection running: every fifth write is a
+// full version, after which the versions below it are collected.
+void testChainSamplingGC() {
+    TThread::set_id(0);
+    tbox_t box;
+    box.nontrans_write(0);
+    unsigned table = MvRegistry::table_id("sampled gc box");
+    TMvBoxAccess::gc_table(box, table);
+    MvRegistry::set_chain_sampling(1);
+
+    for (int i = 0; i < SAMPLED_WRITES; ++i) {
+        RWTRANSACTION {
+            if (i % 5 == 0) {
+                static_cast<TMvBox<int64_t>&>(box) = i;
+            } else {
+                box.increment(1);
+            }
+        } RETRY(true);
+        std::this_thread::sleep_for(2ms);
+    }
+    MvRegistry::set_chain_sampling(0);
+
+    auto st = MvRegistry::stats()[table];
+    assert(st.samples == SAMPLED_WRITES);
+    // each walk ends at the newest full version
+    assert(st.chain.total == st.delta_run.total + SAMPLED_WRITES);
+    assert(st.delta_run.max == 4);
+    std::cout << "Chain sampling test pass!" << std::endl;
+}
+
+#define COLD_WRITES_PER_THREAD 10000
+
+// Commutative increments, after which the thread keeps running unrelated
+// transactions: the box goes cold, and only the MvRegistry collector is
+// left to flatten its delta tail.
+void ColdWriterThread(int thread_id, tbox_t& box, std::atomic<int>& nwritten,
+                      std::atomic<bool>& stop) {
+    TThread::set_id(thread_id);
+
+    for (size_t i = 0; i < COLD_WRITES_PER_THREAD; ++i) {
+        RWTRANSACTION {
+            TXN_DO(true);
+            box.increment(1);
+        } RETRY(true);
+    }
+    ++nwritten;
+    while (!stop.load()) {
+        TRANSACTION {
+            TXN_DO(true);
+        } RETRY(true);
+        std::this_thread::sleep_for(1ms);
+    }
+}
+
+int64_t registry_versions(const std::string& table) {
+    for (auto& t : MvRegistry::stats()) {
+        if (t.name == table) {
+            return t.versions;
+        }
+    }
+    return -1;
+}
+
+void testRegistry() {
+    std::vector<std::thread> thrs;
+    std::atomic<int> nwritten = 0;
+    std::atomic<bool> stop = false;
+    tbox_t box;
+    box.nontrans_write(0);
+    TMvBoxAccess::gc_table(box, MvRegistry::table_id("cold box"));
+    assert(MvRegistry::table_id("cold box") == MvRegistry::table_id("cold box"));
+
+    MvRegistry::start(NUM_WRITER_THREADS + 2);
+    // every thread id used so far, since an idle id would hold back epochs
+    for (int i = 0; i < NUM_WRITER_THREADS + 2; ++i) {
+        thrs.emplace_back(ColdWriterThread, i, std::ref(box), std::ref(nwritten), std::ref(stop));
+    }
+    while (nwritten.load() != NUM_WRITER_THREADS + 2) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    MvHistory<int64_t>* h = nullptr;
+    for (int i = 0; i < 5000; ++i) {
+        h = TMvBoxAccess::latest(box, false);
+        if (h->status() == COMMITTED && registry_versions("cold box") <= 1) {
+            break;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    assert(h->status() == COMMITTED);
+    assert(h->v() == (NUM_WRITER_THREADS + 2) * COLD_WRITES_PER_THREAD);
+    assert(registry_versions("cold box") <= 1);
+
+    stop.store(true);
+    for (auto& t : thrs) {
+        t.join();
+    }
+    MvRegistry::stop();
+    MvRegistry::print_stats(std::cout);
+    std::cout << "Registry test pass!" << std::endl;
+}
+
+#define POOL_INCREMENTS_PER_THREAD 50000ul
+
+void PoolWriterThread(int thread_id, tbox_t& box) {
+    TThread::set_id(thread_id);
+    for (size_t i = 0; i < POOL_INCREMENTS_PER_THREAD; ++i) {
+        RWTRANSACTION {
+            box.increment(1);
+        } RETRY(true);
+    }
+}
+
+// Reads without sleeping, so most reads land on a delta
+void PoolReaderThread(int thread_id, tbox_t& box, std::atomic<bool>& stop) {
+    TThread::set_id(thread_id);
+    int64_t value_so_far = 0;
+    while (!stop.load()) {
+        TRANSACTION {
+            auto [success, v] = box.read_nothrow();
+            assert(v >= value_so_far);
+            value_so_far = v;
+            TXN_DO(success);
+        } RETRY(true);
+    }
+}
+
+void testFlattenPool() {
+    std::vector<std::thread> thrs;
+    std::atomic<bool> stop = false;
+    tbox_t box;
+    box.nontrans_write(0);
+
+    MvFlattenPool::start(NUM_WRITER_THREADS + 2, 2);
+    for (int i = 0; i < NUM_WRITER_THREADS; ++i) {
+        thrs.emplace_back(PoolWriterThread, i, std::ref(box));
+    }
+    for (int i = NUM_WRITER_THREADS; i < NUM_WRITER_THREADS + 2; ++i) {
+        thrs.emplace_back(PoolReaderThread, i, std::ref(box), std::ref(stop));
+    }
+    for (int i = 0; i < NUM_WRITER_THREADS; ++i) {
+        thrs[i].join();
+    }
+    stop.store(true);
+    for (int i = NUM_WRITER_THREADS; i < NUM_WRITER_THREADS + 2; ++i) {
+        thrs[i].join();
+    }
+
+    int64_t final_value = -1;
+    TRANSACTION {
+        auto [success, v] = box.read_nothrow();
+        TXN_DO(success);
+        final_value = v;
+    } RETRY(true);
+    assert(final_value == int64_t(NUM_WRITER_THREADS * POOL_INCREMENTS_PER_THREAD));
+
+    auto st = MvFlattenPool::stats();
+    assert(st.flattened + st.overflows > 0);
+    MvFlattenPool::stop();
+    std::cout << "Flatten pool: " << st.flattened << " flattened, "
+              << st.overflows << " overflowed" << std::endl;
+    std::cout << "Flatten pool test pass!" << std::endl;
+}
+
+// A queued object must stay allocated until a worker is done with it, so
+// active_epoch may not pass the epoch of an entry while it waits behind
+// other entries or is being flattened. Threads that have finished keep
+// their last epochs, so this runs before any other thread.
+void testFlattenPoolEpochPin() {
+    typedef TRcuSet::signed_epoch_type signed_epoch_type;
+    auto& ge = Transaction::global_epochs;
+    static std::atomic<TRcuSet::epoch_type> active_seen;
+    active_seen = 0;
+    // each takes a few epochs
+    auto slow_flatten = [] (void*) {
+        std::this_thread::sleep_for(3ms);
+    };
+    auto observing_flatten = [] (void*) {
+        active_seen = Transaction::global_epochs.active_epoch.load();
+    };
+    // keeps this thread's own epoch from holding active_epoch back
+    auto refresh_epoch = [] {
+        TRANSACTION {
+        } RETRY(false);
+        std::this_thread::sleep_for(100us);
+    };
+
+    TThread::set_id(0);
+    MvFlattenPool::start(NUM_WRITER_THREADS + 2, 1);
+    TRcuSet::epoch_type epoch = 0;
+    TRANSACTION {
+        epoch = Transaction::this_thread().write_snapshot_epoch.load();
+        for (int i = 0; i != 10; ++i)
+            assert(MvFlattenPool::enqueue(slow_flatten, nullptr));
+        assert(MvFlattenPool::enqueue(observing_flatten, nullptr));
+    } RETRY(false);
+
+    while (!active_seen.load())
+        refresh_epoch();
+    assert(signed_epoch_type(ge.global_epoch.load() - epoch) > 2);
+    assert(signed_epoch_type(active_seen.load() - epoch) <= 0);
+    for (int i = 0; i != 1000 && signed_epoch_type(ge.active_epoch.load() - epoch) <= 0; ++i)
+        refresh_epoch();
+    assert(signed_epoch_type(ge.active_epoch.load() - epoch) > 0);
+    MvFlattenPool::stop();
+    std::cout << "Flatten pool epoch pin test pass!" << std::endl;
+}
+
 int main() {
     std::vector<std::thread> thrs;
     std::thread epoch_advancer;
@@ -74,6 +442,7 @@ int main() {
     Transaction::set_epoch_cycle(1000);
     epoch_advancer = std::thread(&Transaction::epoch_advancer, nullptr);
     epoch_advancer.detach();
+    testFlattenPoolEpochPin();
 
     for (int i = 0; i < NUM_WRITER_THREADS; ++i) {
         thrs.emplace_back(ConcurrentThreadIncrement, i, std::ref(box));
@@ -92,6 +461,13 @@ int main() {
     }
     std::cout << "Test pass!" << std::endl;
 
+    testSnapshot();
+    testIdleLease();
+    testChainSamplingGC();
+    testLatestCache();
+    testRegistry();
+    testFlattenPool();
+
     Transaction::epoch_advance_once();
     Transaction::epoch_advance_once();
     Transaction::rcu_release_all(epoch_advancer, NUM_WRITER_THREADS + 2);
@@ -297,6 +297,91 @@ void testMvWrites() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testMvReadLease() {
+    TMvBox<int> f, g;
+    f.nontrans_write(1);
+    g.nontrans_write(0);
+    Transaction::set_mvcc_read_lease(16);
+
+    // A leased read invalidates writes it would otherwise let through
+    {
+        TestTransaction t1(1);
+        Sto::mvcc_rw_upgrade();
+        g = f;
+
+        TestTransaction t2(2);
+        Sto::mvcc_rw_upgrade();
+        f = 2;
+
+        t1.use();
+        assert(t1.try_commit());
+
+        t2.use();
+        assert(!t2.try_commit());
+    }
+
+    // After that abort f is read without a lease until a write gets through
+    {
+        TestTransaction t1(1);
+        Sto::mvcc_rw_upgrade();
+        g = f + 1;
+
+        TestTransaction t2(2);
+        Sto::mvcc_rw_upgrade();
+        f = 3;
+
+        t1.use();
+        assert(t1.try_commit());
+
+        t2.use();
+        assert(t2.try_commit());
+    }
+
+    // Reads within the lease leave rtid alone
+    {
+        TestTransaction t3(3);
+        Sto::mvcc_rw_upgrade();
+        g = f;
+        assert(t3.try_commit());
+    }
+    auto h = TMvBoxAccess::latest(f, false);
+    auto rtid = h->rtid();
+    {
+        TestTransaction t3(3);
+        Sto::mvcc_rw_upgrade();
+        g = f + 1;
+        assert(t3.try_commit());
+    }
+    assert(h->rtid() == rtid);
+
+    Transaction::set_mvcc_read_lease(0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testChainSampling() {
+    TMvCommuteIntegerBox box;
+    box.nontrans_write(0);
+    unsigned table = MvRegistry::table_id("sampled box");
+    TMvBoxAccess::gc_table(box, table);
+    MvRegistry::set_chain_sampling(1);
+
+    for (int i = 0; i < 10; ++i) {
+        RWTRANSACTION {
+            box.increment(1);
+        } RETRY(false);
+    }
+    MvRegistry::set_chain_sampling(0);
+
+    auto st = MvRegistry::stats()[table];
+    assert(st.name == "sampled box");
+    assert(st.samples == 10);
+    assert(st.delta_run.max == 10);
+    assert(st.delta_run.total == 55);
+    assert(st.chain.max >= 11);
+    assert(st.delta_run.buckets[MvRegistry::length_bucket(10)] == 3);  // 8, 9, 10
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 void testMvCommute1() {
     TMvCommuteIntegerBox box;
     box.nontrans_write(0);
@@ -447,6 +532,121 @@ void testCommuteGC() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+struct stats_row {
+    int64_t total;
+    int64_t lo;
+    int64_t hi;
+    uint64_t flags;
+};
+
+std::ostream& operator<<(std::ostream& w, const stats_row& r) {
+    return w << "{" << r.total << " " << r.lo << " " << r.hi << " " << r.flags << "}";
+}
+
+namespace commutators {
+template <>
+class Commutator<stats_row>
+    : public compose<stats_row,
+                     field_op<&stats_row::total, add_op<int64_t>>,
+                     field_op<&stats_row::lo, min_op<int64_t>>,
+                     field_op<&stats_row::hi, max_op<int64_t>>,
+                     field_op<&stats_row::flags, or_op<uint64_t>>> {
+public:
+    using compose::compose;
+
+    // records one sample
+    explicit Commutator(int64_t x)
+        : compose(add_op<int64_t>(x), min_op<int64_t>(x), max_op<int64_t>(x),
+                  or_op<uint64_t>(uint64_t(1) << (x & 63))) {}
+};
+}
+
+void testCommuteLibrary() {
+    using namespace commutators;
+    TMvBox<stats_row> box;
+    box.nontrans_write({0, 100, -100, 0});
+
+    {
+        TestTransaction t1(1);
+        Sto::mvcc_rw_upgrade();
+        box.commute(Commutator<stats_row>(5));
+        TestTransaction t2(2);
+        Sto::mvcc_rw_upgrade();
+        box.commute(Commutator<stats_row>(-3));
+        TestTransaction t3(3);
+        Sto::mvcc_rw_upgrade();
+        box.commute(Commutator<stats_row>(120));
+        assert(t3.try_commit());
+        t1.use();
+        assert(t1.try_commit());
+        t2.use();
+        assert(t2.try_commit());
+    }
+    {
+        TestTransaction t(4);
+        Sto::mvcc_rw_upgrade();
+        stats_row r = box.read();
+        assert(r.total == 122 && r.lo == -3 && r.hi == 120);
+        assert(r.flags == ((1ul << 5) | (1ul << (-3 & 63)) | (1ul << (120 & 63))));
+        assert(t.try_commit());
+    }
+
+    int64_t balance = 10;
+    floored_add_op<int64_t>(-25, 0).operate(balance);
+    assert(balance == 0);
+    uint8_t bits = 0xff;
+    and_op<uint8_t>(0x0f).operate(bits);
+    assert(bits == 0x0f);
+
+    bounded_log<int, 4> log;
+    for (int i = 1; i <= 6; ++i)
+        Commutator<bounded_log<int, 4>>(i).operate(log);
+    assert(log.size() == 4 && log.total() == 6);
+    assert(log[0] == 3 && log[3] == 6);
+
+    hyperloglog<10> a, b;
+    for (uint64_t i = 0; i < 20000; ++i) {
+        // splitmix64
+        uint64_t hash = (i + 1) * 0x9E3779B97F4A7C15ul;
+        hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ul;
+        hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBul;
+        hash ^= hash >> 31;
+        Commutator<hyperloglog<10>>(hash).operate(i % 2 ? a : b);
+    }
+    hll_merge_op<10>(b).operate(a);
+    assert(std::abs(a.estimate() - 20000) < 20000 * 0.1);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testMvLongChain() {
+    TMvBox<int> box;
+    box.nontrans_write(0);
+
+    for (int i = 1; i <= 600; ++i) {
+        TestTransaction t(1);
+        Sto::mvcc_rw_upgrade();
+        box = i;
+        assert(t.try_commit());
+    }
+
+    {
+        TestTransaction t(2);
+        Sto::mvcc_rw_upgrade();
+        auto head = TMvBoxAccess::head(box);
+        assert(head->v() == 600);
+        auto obj = head->object();
+        // every old snapshot still sees its own version
+        for (auto h = head; h->prev(); h = h->prev()) {
+            assert(obj->find(h->wtid()) == h);
+            assert(obj->find(h->wtid() - 1)->v() == h->v() - 1);
+        }
+        assert(t.try_commit());
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 
 int main() {
     testSimpleInt();
@@ -455,9 +655,13 @@ int main() {
     testOpacity1();
     testMvReads();
     testMvWrites();
+    testMvReadLease();
+    testChainSampling();
     testMvCommute1();
     testMvCommute2();
     testCommuteGC();
+    testMvLongChain();
+    testCommuteLibrary();
 #if MVCC_INLINING
     testMvInline();
 #endif